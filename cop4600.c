@@ -13,8 +13,16 @@
 #include <sys/pool.h>
 #include <sys/queue.h>
 #include <sys/mount.h>
+#include <sys/fcntl.h>
+#include <sys/stat.h>
+#include <sys/event.h>
+#include <sys/buf.h>
 #include <sys/syscallargs.h>
 
+#include <uvm/uvm_extern.h>
+
+#include <machine/cpu.h>
+
 /*========================================================================**
 **  Dave's example system calls                                           **
 **========================================================================*/
@@ -69,6 +77,56 @@ sys_showargs( struct proc *p, void *v, register_t *retval )
   return (0);
 }
 
+/*
+** null() does nothing: what is left is the fixed cost of a system call,
+** the trap, the sysent dispatch and the return to user mode
+*/
+
+int
+sys_null( struct proc *p, void *v, register_t *retval )
+{
+  *retval = 0;
+
+  return (0);
+}
+
+/*
+** null_args() does nothing with six arguments: the difference from
+** null() is the trap handler copying the argument words in from the
+** user stack
+*/
+
+int
+sys_null_args( struct proc *p, void *v, register_t *retval )
+{
+  *retval = 0;
+
+  return (0);
+}
+
+/*
+** null_str() copies a string in and returns its length, NUL included:
+** showargs() without the uprintf(), to time copyinstr() by string size
+*/
+
+int
+sys_null_str( struct proc *p, void *v, register_t *retval )
+{
+  struct sys_null_str_args *uap = v;
+
+  char kstr[MAX_STR_LENGTH+1]; /* will hold kernal-space copy of uap->str */
+  int err = 0;
+  size_t size = 0;
+
+  err = copyinstr( SCARG(uap, str), &kstr, MAX_STR_LENGTH, &size );
+  if (err != 0)
+    return( err );
+
+  *retval = size;
+
+  return (0);
+}
+
 /*========================================================================**
 **  Dawit's COP4600 2004C system calls                                    **
 **========================================================================*/
@@ -79,7 +137,34 @@ sys_showargs( struct proc *p, void *v, register_t *retval )
 #define min(a,b) (((a) > (b)) ? (b) : (a))  // compute minimum value
 
 void substitution (char *text, int textLength, int lkey, int nkey);
-void transposition (char *text, int textLength, int lkey, int nkey);
+struct cipher_table *cipher_lookup (int lkey, int nkey);
+u_char *substitution_table (int lkey, int nkey);
+u_char *inverse_table (int lkey, int nkey);
+void cipher_apply (char *text, int textLength, u_char *table);
+int cipher_user (char *ubuf, size_t len, int lkey, int nkey, int inverse,
+    size_t *done);
+
+/*
+ * For a given key pair substitution() is a fixed byte-to-byte mapping, so
+ * it is run once over all 256 byte values and the result kept as a table,
+ * along with its inverse for deciphering.  Only lkey % 26, the sign and
+ * parity of lkey and nkey % 10 change the mapping; the last few distinct
+ * keys are cached, replaced round robin.
+ */
+#define CIPHER_TABLES 4
+
+struct cipher_table
+{
+  int valid;
+  int lshift;                       // lkey % 26
+  int lflip;                        // lkey negative and odd
+  int nshift;                       // nkey % 10
+  u_char map[256];                  // substitution()
+  u_char inverse[256];              // map run backwards
+};
+
+struct cipher_table cipher_tables[CIPHER_TABLES];
+int cipher_next;                    // next slot to replace
 
 /* 
 ** TigerCipher® : Protecting us against canine digital attack
@@ -108,11 +193,8 @@ sys_cipher (struct proc *p, void *v, register_t *retval)
   klkey = SCARG(args, lkey);
   knkey = SCARG(args, nkey);
 
-  // Pass 1
-  substitution(ktext, textSize, klkey, knkey);
-
-  // Pass 2
-  transposition(ktext, textSize, klkey, knkey);
+  // Both passes at once
+  cipher_apply(ktext, textSize, substitution_table(klkey, knkey));
 
   /* Copy text to user space */
   err = copyoutstr(&ktext, SCARG(args, text), MAX_STR_LENGTH+1 , &textSize);
@@ -124,6 +206,111 @@ sys_cipher (struct proc *p, void *v, register_t *retval)
   return (0);
 }
 
+/*
+** Length-delimited cipher of len bytes in place: 314
+**
+** The buffer is binary, NULs and all, and may be any size.
+*/
+
+int
+sys_cipher_buffer (struct proc *p, void *v, register_t *retval)
+{
+  struct sys_cipher_buffer_args *args = v;
+  size_t done;                       /* bytes ciphered */
+  int err;
+
+  err = cipher_user(SCARG(args, buf), SCARG(args, len), SCARG(args, lkey),
+      SCARG(args, nkey), 0, &done);
+  if(err != 0)
+    return (err);
+
+  *retval = done;
+
+  return (0);
+}
+
+/*
+** Cipher nvec buffers in place in one call, readv style: 315
+**
+** Every buffer is ciphered with (lkey, nkey), or with its own cv_lkey and
+** cv_nkey under CIPHER_OWNKEYS, and deciphered instead under
+** CIPHER_INVERSE.  A bad buffer does not stop the batch: its
+** cv_error and cv_done say how far it got, and the array is copied back
+** with every entry filled in.  Returns the number of buffers done whole.
+*/
+
+int
+sys_cipher_vector (struct proc *p, void *v, register_t *retval)
+{
+  struct sys_cipher_vector_args *args = v;
+  struct cipher_vec *kvec, *cv;      /* kernel space copy of the array */
+  int knvec = SCARG(args, nvec);     /* kernel copy of nvec */
+  int kflags = SCARG(args, flags);   /* kernel copy of flags */
+  int i, ok;
+
+  if(knvec < 0 || knvec > CIPHER_VEC_MAX || (kflags & ~CIPHER_FLAGS))
+    return (EINVAL);
+
+  kvec = (struct cipher_vec *) malloc(knvec * sizeof(*kvec) + 1, M_TEMP,
+      M_WAITOK);
+  if(copyin(SCARG(args, vec), kvec, knvec * sizeof(*kvec)) != 0)
+  {
+    free(kvec, M_TEMP);
+    return (EFAULT);
+  }
+
+  ok = 0;
+  for(i = 0; i < knvec; ++i)
+  {
+    cv = &kvec[i];
+    if(!(kflags & CIPHER_OWNKEYS))
+    {
+      cv->cv_lkey = SCARG(args, lkey);
+      cv->cv_nkey = SCARG(args, nkey);
+    }
+    cv->cv_error = cipher_user(cv->cv_base, cv->cv_len, cv->cv_lkey,
+        cv->cv_nkey, kflags & CIPHER_INVERSE, &cv->cv_done);
+    if(cv->cv_error == 0)
+      ++ok;
+  }
+
+  if(copyout(kvec, SCARG(args, vec), knvec * sizeof(*kvec)) != 0)
+  {
+    free(kvec, M_TEMP);
+    return (EFAULT);
+  }
+  free(kvec, M_TEMP);
+
+  *retval = ok;
+
+  return (0);
+}
+
+/*
+** Undo sys_cipher_buffer() on len bytes in place: 316
+**
+** Substitution maps each byte on its own and transposition only swaps
+** chars within a quad (or short quad), which undoes itself.  So the
+** inverse is the same fused pass run with the substitution table inverted.
+*/
+
+int
+sys_decipher_buffer (struct proc *p, void *v, register_t *retval)
+{
+  struct sys_decipher_buffer_args *args = v;
+  size_t done;                       /* bytes deciphered */
+  int err;
+
+  err = cipher_user(SCARG(args, buf), SCARG(args, len), SCARG(args, lkey),
+      SCARG(args, nkey), 1, &done);
+  if(err != 0)
+    return (err);
+
+  *retval = done;
+
+  return (0);
+}
+
 /* --------- END SYSTEM CALL --------- */
 
 /* --------- HELPER FUCNTION --------- */
@@ -195,52 +382,134 @@ void substitution (char *text, int textLength, int lkey, int nkey)
 
 }
 
-/* Split text into quads and transpose elements */
-void transposition (char *text, int textLength, int lkey, int nkey)
+/* Find or build the tables for (lkey, nkey) */
+struct cipher_table *cipher_lookup (int lkey, int nkey)
+{
+  struct cipher_table *t;
+  int i;
+  int lshift = lkey % 26;
+  int lflip = ((lkey < 0) && (lkey & 0x1));
+  int nshift = nkey % 10;
+
+  for(i = 0; i < CIPHER_TABLES; ++i)
+  {
+    t = &cipher_tables[i];
+    if(t->valid && t->lshift == lshift && t->lflip == lflip &&
+        t->nshift == nshift)
+      return (t);
+  }
+
+  // miss: run the per-character code once over every byte value
+  t = &cipher_tables[cipher_next];
+  cipher_next = (cipher_next + 1) % CIPHER_TABLES;
+  for(i = 0; i < 256; ++i)
+    t->map[i] = i;
+  substitution((char *)t->map, 256, lkey, nkey);
+
+  // the mapping is one to one, so it can be run backwards
+  for(i = 0; i < 256; ++i)
+    t->inverse[t->map[i]] = i;
+
+  t->lshift = lshift;
+  t->lflip = lflip;
+  t->nshift = nshift;
+  t->valid = 1;
+
+  return (t);
+}
+
+/* Table that does substitution() for (lkey, nkey) */
+u_char *substitution_table (int lkey, int nkey)
+{
+  return (cipher_lookup(lkey, nkey)->map);
+}
+
+/* Table that undoes substitution() for (lkey, nkey) */
+u_char *inverse_table (int lkey, int nkey)
+{
+  return (cipher_lookup(lkey, nkey)->inverse);
+}
+
+/*
+ * Cipher (or decipher, with inverse set) len bytes of a user buffer in
+ * place, CIPHER_CHUNK bytes at a time:
+ * each chunk is copied in, ciphered and copied back out before the next,
+ * so only one chunk is ever on the stack.  A chunk holds whole quads, so
+ * only the last one can have a short quad.  On a fault the chunks before
+ * it have already been written back, and *done says how many bytes.
+ */
+
+#define CIPHER_CHUNK 1024           /* multiple of 4 */
+
+int cipher_user (char *ubuf, size_t len, int lkey, int nkey, int inverse,
+    size_t *done)
+{
+  char kchunk[CIPHER_CHUNK];        /* kernel space copy of one chunk */
+  size_t n;                         /* chunk size */
+
+  *done = 0;
+  if ((ssize_t)len < 0)
+    return (EINVAL);
+
+  for(; *done < len; *done += n)
+  {
+    n = min(len - *done, CIPHER_CHUNK);
+    if(copyin(ubuf + *done, kchunk, n) != 0)
+      return (EFAULT);
+
+    /* look the table up again: copyin may have slept and evicted it */
+    cipher_apply(kchunk, n, inverse ? inverse_table(lkey, nkey) :
+        substitution_table(lkey, nkey));
+
+    if(copyout(kchunk, ubuf + *done, n) != 0)
+      return (EFAULT);
+  }
+
+  return (0);
+}
+
+/*
+ * Substitution and transposition in a single pass.  Substitution maps each
+ * byte on its own, so it can be done on the quad as it is transposed: the
+ * four chars are looked up into registers and stored back swapped, and the
+ * text is read and written once instead of twice.  Packing the four into a
+ * word for a single store measured no faster: the table loads dominate.
+ */
+void cipher_apply (char *text, int textLength, u_char *table)
 {
-  // detemine extra chars at the end
   int i;                            // iterator
-  char temp;                        // swap space
+  u_char a, b, c, d;                // substituted quad
   int nonQuad = textLength % 4;     // quad length < 4
-  
-  // process each normal quad with length = 4
-  for(i = 0; i < (textLength - nonQuad); i+=4)
-  {
-    // swap 1st and 3th chars
-    temp = text[i];
-    text[i] = text[i+2];
-    text[i+2] = temp;
-    
-    // swap 2nd and 4th chars
-    temp = text[i+1];
-    text[i+1] = text[i+3];
-    text[i+3] = temp;
+
+  for(i = 0; i < (textLength - nonQuad); i += 4)
+  {
+    a = table[(u_char)text[i]];
+    b = table[(u_char)text[i+1]];
+    c = table[(u_char)text[i+2]];
+    d = table[(u_char)text[i+3]];
+    text[i] = c;
+    text[i+1] = d;
+    text[i+2] = a;
+    text[i+3] = b;
   }
-  
-  /* 
-   * This will only be evaluated when the last "quad" of the
-   * string contains a quad of length 1 to 3
-   */
 
-  if(nonQuad)
+  // the short quad: abc -> cba, ab -> ba, a -> a
+  if (nonQuad == 3)
   {
-    /* i is now at the 1st index of this weird "quad" */
-    if (nonQuad == 3)
-    {
-      // swap 1st and 3rd chars
-      temp = text[i];
-      text[i] = text[i+2];
-      text[i+2] = temp;
-    }
-    else if (nonQuad == 2)
-    {
-      // swap 1st and 2nd chars
-      temp = text[i];
-      text[i] = text[i+1];
-      text[i+1] = temp;
-    }
-      /* leave the lonely char alone */
+    a = table[(u_char)text[i]];
+    b = table[(u_char)text[i+1]];
+    text[i] = table[(u_char)text[i+2]];
+    text[i+1] = b;
+    text[i+2] = a;
   }
+  else if (nonQuad == 2)
+  {
+    a = table[(u_char)text[i]];
+    text[i] = table[(u_char)text[i+1]];
+    text[i+1] = a;
+  }
+  else if (nonQuad == 1)
+    text[i] = table[(u_char)text[i]];
 }
 
 /* --------- END HELPER FUNCTION --------- */
@@ -262,14 +531,72 @@ void transposition (char *text, int textLength, int lkey, int nkey)
     {return EFAULT;}  \
 } while(0)
 
-#define NAMECHECK(kname, length, err) do {  \
+/*
+ * Reject unterminated names, then intern the name as a 64-bit key while it
+ * is still in cache from copyinstr: lookups compare keys and only fall back
+ * on strcmp when the keys match.
+ */
+#define NAMECHECK(kname, length, key, err) do {  \
     if (length == MAX_NAME_LENGTH && kname[MAX_NAME_LENGTH-1] != '\0')  \
     {return err;} \
+    key = sem_key(kname, length - 1); \
 } while (0)
 
+#define SAMENAME(sem, kname, key) ((sem)->key == (key) && strcmp((sem)->name, (kname)) == EQUAL)
+
+
+#define SEM_HASH_SIZE 64               /* buckets in the group and global namespaces */
+#define SEM_KNOTE_GONE 1               /* knote hint: semaphore destroyed */
+#define GLOBALNAME(kname) ((kname)[0] == '/')
 
 /* helper functions */
-semaphore_t* find_semaphore(struct proc *p, char *kname);
+semaphore_t* find_semaphore(struct proc *p, char *kname, u_int64_t key);
+semaphore_t* find_pgrp_semaphore(struct pgrp *pg, char *kname, u_int64_t key);
+semaphore_t* find_global_semaphore(char *kname, u_int64_t key);
+int create_semaphore(struct proc *p, char *kname, u_int64_t key, int type,
+    int nsems, int kcount, int scope, int mode, int flags,
+    struct sem_ring *ring);
+void destroy_semaphore(semaphore_t *sem);
+void sem_unref(semaphore_t *sem);
+void sem_release(semaphore_t *sem);
+int sem_down(struct proc *p, semaphore_t *sem, int idx);
+int sem_up(struct proc *p, semaphore_t *sem, int idx);
+void sem_up_barge(semaphore_t *sem, struct sem_slot *slot);
+int sem_sleep(struct proc *p, semaphore_t *sem, struct sem_slot *slot, char *wmesg);
+void sem_wakeall(semaphore_t *sem, struct sem_slot *slot, int state);
+void sem_post(struct p_node *np, int state);
+void sem_unqueue(struct sem_slot *slot, struct p_node *np);
+void sem_take(struct proc *p, semaphore_t *sem, struct sem_slot *slot);
+struct proc* sem_give(semaphore_t *sem);
+void sem_boost(struct proc *hp, int pri);
+void sem_unboost(struct proc *p);
+int sem_toppri(struct sem_slot *slot);
+int sem_trydown(struct sem_slot *slot);
+void chan_put(struct sem_ring *ring, char *msg, int len);
+int chan_get(struct sem_ring *ring, char *msg);
+u_int64_t sem_key(char *kname, int length);
+u_int sem_hash(pid_t id, u_int64_t key);
+int sem_access(struct ucred *cred, semaphore_t *sem, int mode);
+int filt_semattach(struct knote *kn);
+void filt_semdetach(struct knote *kn);
+int filt_sem(struct knote *kn, long hint);
+
+struct filterops sem_filtops =
+  { 0, filt_semattach, filt_semdetach, filt_sem };
+
+/*
+ * Process group namespace: semaphores allocated with SEM_SCOPE_PGRP hang off
+ * a system wide hash table keyed by (group, name) instead of their creator's
+ * list, so any member of the group finds them in one probe.
+ */
+LIST_HEAD(sem_hashhead, semaphore) sem_pgrphash[SEM_HASH_SIZE];
+int sem_npgrp;                         /* group semaphores system wide */
+
+/*
+ * Global namespace: named semaphores shared by unrelated processes, keyed by
+ * name alone and guarded by the creator's credentials and mode.
+ */
+struct sem_hashhead sem_globalhash[SEM_HASH_SIZE];
 
 /*
  * Create and initialize semaphore: 292
@@ -278,42 +605,75 @@ int
 sys_allocate_semaphore (struct proc *p, void *v, register_t *retval)
 {
   struct sys_allocate_semaphore_args *uap = v;  
-  semaphore_t *sem;                              
   char kname[MAX_NAME_LENGTH]; 
-  int kcount;
+  u_int64_t key;
   int length;
 
   length = 0;
 
   COPYNAME(kname, uap, length);  
-  NAMECHECK(kname, length, ENAMETOOLONG);
-  LIST_FOREACH(sem, &(p->semaphores), s_next)
-    if (strcmp(sem->name, kname) == EQUAL && sem->owner == p)
-      return EEXIST;   /* process owns semaphore with that name */
+  NAMECHECK(kname, length, key, ENAMETOOLONG);
+  return create_semaphore(p, kname, key, SEM_TYPE_SEMAPHORE, 1,
+                          SCARG(uap, initial_count), SEM_SCOPE_PROC, 0, 0, NULL);
+}
 
-  kcount = SCARG(uap, initial_count); 
-  if (kcount < 0)
-    return EDOM;            /* out of range */
-  
-  /* allocate memeory for semaphore right now */
-  sem = (struct semaphore*) malloc(sizeof(struct semaphore), M_PROC, M_NOWAIT);
-  if (sem == NULL)
-    return ENOMEM;     /* not enough memeory */
+/*
+ * Create semaphore in the given namespace: 296
+ */
+int
+sys_allocate_semaphore_scope (struct proc *p, void *v, register_t *retval)
+{
+  struct sys_allocate_semaphore_scope_args *uap = v;
+  char kname[MAX_NAME_LENGTH];
+  u_int64_t key;
+  int length;
+  int kscope;
 
-  /* initialize semaphore */
-  if (copystr(&kname, &sem->name, MAX_NAME_LENGTH, &length) == EFAULT)
-  {     
-    /* something bad happaned. abort*/                  
-    free(sem, M_PROC);        
-    return EFAULT;
+  length = 0;
+
+  COPYNAME(kname, uap, length);
+  NAMECHECK(kname, length, key, ENAMETOOLONG);
+
+  kscope = SCARG(uap, scope);
+  if (kscope != SEM_SCOPE_PROC && kscope != SEM_SCOPE_PGRP)
+    return EINVAL;
+  return create_semaphore(p, kname, key, SEM_TYPE_SEMAPHORE, 1,
+                          SCARG(uap, initial_count), kscope, 0, 0, NULL);
+}
+
+/*
+ * Create or look up a global named semaphore, sem_open() style: 297
+ */
+int
+sys_open_semaphore (struct proc *p, void *v, register_t *retval)
+{
+  struct sys_open_semaphore_args *uap = v;
+  semaphore_t *sem;
+  char kname[MAX_NAME_LENGTH];
+  u_int64_t key;
+  int length;
+  int koflag;
+
+  length = 0;
+
+  COPYNAME(kname, uap, length);
+  NAMECHECK(kname, length, key, ENAMETOOLONG);
+  if (!GLOBALNAME(kname))
+    return EINVAL;          /* global names start with '/' */
+
+  koflag = SCARG(uap, oflag);
+  sem = find_global_semaphore(kname, key);
+  if (sem != NULL)
+  {
+    if ((koflag & (O_CREAT | O_EXCL)) == (O_CREAT | O_EXCL))
+      return EEXIST;
+    return sem_access(p->p_ucred, sem, S_IRUSR | S_IWUSR);
   }
-  sem->owner = p;
-  sem->count = kcount;
-  SIMPLEQ_INIT(&(sem->p_head));
-  lockinit(&sem->mutex, p->p_priority,"semaphore: another process in critical section", 0, LK_CANRECURSE);
-  LIST_INSERT_HEAD(&p->semaphores, sem, s_next);
-  //++sys_semaphores;
-  return(0);
+  if ((koflag & O_CREAT) == 0)
+    return ENOENT;
+  return create_semaphore(p, kname, key, SEM_TYPE_SEMAPHORE, 1,
+                          SCARG(uap, initial_count), SEM_SCOPE_GLOBAL,
+                          SCARG(uap, mode), 0, NULL);
 }
 
 /*
@@ -326,44 +686,23 @@ sys_down_semaphore (struct proc *p, void *v, register_t *retval)
   struct sys_down_semaphore_args *uap = v;
   semaphore_t *sem;
   char kname[MAX_NAME_LENGTH]; 
+  u_int64_t key;
   int length;
-  int flag;
-  struct p_node *np;
 
   length = 0;
-  flag = 1;
 
   /* Get semaphore */
   COPYNAME(kname, uap, length);
-  NAMECHECK(kname, length, ENOENT);  
-  sem = find_semaphore(p, kname);
+  NAMECHECK(kname, length, key, ENOENT);  
+  sem = find_semaphore(p, kname, key);
   if(sem == NULL)
     return ENOENT;
+  if (sem->scope == SEM_SCOPE_GLOBAL && sem_access(p->p_ucred, sem, S_IWUSR) != 0)
+    return EACCES;
+  if (sem->type != SEM_TYPE_SEMAPHORE)
+    return EINVAL;          /* name belongs to a barrier */
 
-  lockmgr(&sem->mutex, LK_EXCLUSIVE, NULL, p);  /* Lock mutex */
-  --sem->count;
-  if(sem->count < 0)
-  { 
-    /* create and instantiate node of SIMPLEQ */
-    np = (struct p_node*) malloc (sizeof(struct p_node), M_PROC, M_NOWAIT);
-    if(np == NULL)
-      return ENOMEM;
-    np->p = p;
-    /* 
-     * Make a process sleep on itself. This way, we wont have to worry about
-     * notifying other processes upon wakeup. Each process will sleep on a 
-     * unique "object" i.e itself
-     */
-    SIMPLEQ_INSERT_TAIL(&sem->p_head, np, p_next);   /* add process to wait queue */
-    lockmgr(&sem->mutex, LK_RELEASE, NULL, p);       /* release lock before sleeping */
-    
-    while (flag != 0)         /* break out of this loop only if wakeup() is called */
-      flag = tsleep((void*) np->p, p->p_priority,"waiting on semaphore",0);
-      
-    lockmgr(&sem->mutex, LK_EXCLUSIVE, NULL, p);     /* lock mutex */
-  }
-  lockmgr(&sem->mutex, LK_RELEASE, NULL, p);      /* Unlock mutex */
-  return(0);
+  return sem_down(p, sem, 0);
 }
 
 /*
@@ -376,33 +715,24 @@ sys_up_semaphore (struct proc *p, void *v, register_t *retval)
   struct sys_up_semaphore_args *uap = v;
   semaphore_t *sem;
   char kname[MAX_NAME_LENGTH]; 
+  u_int64_t key;
   int length;
-  struct p_node *np;
 
   length = 0;
 
   /* Get semaphore */
   COPYNAME(kname, uap, length);
-  NAMECHECK(kname, length, ENOENT);
+  NAMECHECK(kname, length, key, ENOENT);
 
-  sem = find_semaphore(p, kname);
+  sem = find_semaphore(p, kname, key);
   if(sem == NULL)
     return ENOENT;
+  if (sem->scope == SEM_SCOPE_GLOBAL && sem_access(p->p_ucred, sem, S_IWUSR) != 0)
+    return EACCES;
+  if (sem->type != SEM_TYPE_SEMAPHORE)
+    return EINVAL;          /* name belongs to a barrier */
 
-  lockmgr(&sem->mutex, LK_EXCLUSIVE, NULL, p);  /* Lock mutex */
-  ++sem->count;
-
-  if(sem->count <= 0)
-  {
-    /* Signal first process in wait list */
-    np = SIMPLEQ_FIRST(&sem->p_head);
-    wakeup((void*) np->p);
-    SIMPLEQ_REMOVE_HEAD(&sem->p_head, np, p_next);  /* delete node */
-    free(np, M_PROC);                               /* free memory */
-  }
-  /* Unlock mutex */
-  lockmgr(&sem->mutex, LK_RELEASE, NULL, p);
-  return(0);
+  return sem_up(p, sem, 0);   /* EPERM unless the holder of a mutex */
 }
 
 /*
@@ -416,73 +746,1480 @@ sys_free_semaphore (struct proc *p, void *v, register_t *retval)
   struct sys_free_semaphore_args *uap = v;  
   semaphore_t *sem;                              
   char kname[MAX_NAME_LENGTH]; 
+  u_int64_t key;
   int length;
 
   length = 0;
 
   /* if name is not in proper format, don't bother checking */
   COPYNAME(kname, uap, length);
-  NAMECHECK(kname, length, ENOENT);
+  NAMECHECK(kname, length, key, ENOENT);
 
-  sem = find_semaphore(p, kname);
+  sem = find_semaphore(p, kname, key);
   if(sem == NULL)
     return ENOENT;    /* process doesn't own such semaphore */
+  if (sem->scope == SEM_SCOPE_GLOBAL && p->p_ucred->cr_uid != 0 &&
+      p->p_ucred->cr_uid != sem->uid)
+    return EPERM;     /* only the creator or root may remove it */
 
-  LIST_REMOVE(sem, s_next);   /* Remove from system list*/
-  /* Delete all internals */
-  /* Do I need to empty the queue? WHEN? HOW?* --- SEE DAVE'S COMMENT ON HINTS?*/  
-  lockmgr(&sem->mutex, LK_DRAIN, NULL, p);    /* drain lock */
-  free(sem, M_PROC);                          /* Free memory */
-  //--semaphore_count;
+  /* Waiters are woken with ENOENT rather than left asleep forever */
+  destroy_semaphore(sem);
   return(0);
 }
 
 
-/* Get semaphore with presedence according to creation - traverse the process tree bottom-up */
-semaphore_t* find_semaphore(struct proc *p, char *kname)
+/*
+ * Create a set of nsems semaphores under one name: 298
+ */
+int
+sys_allocate_semaphore_set (struct proc *p, void *v, register_t *retval)
 {
-  semaphore_t *sem;
-  struct proc *p_find;      /* Process to search through */
-  int breakloop;            /* flag to exit */
-
-  p_find = p;             /* Start with current process */
-  sem = NULL;
-  breakloop = FALSE;
-
-  /* Go through all the semaphores I created */
-  while((LIST_EMPTY(&p_find->semaphores) == FALSE || p_find->inherited == TRUE) && breakloop == FALSE)      
-  {  
-    /* Until I get to a process that neither has created semaphore or inherited them */
-    LIST_FOREACH(sem, &p_find->semaphores, s_next)
-    {
-      /* Search through the process's semaphore list for such name */
-      if(strcmp(sem->name, kname) == EQUAL && sem->owner == p_find)
-      {
-        breakloop = TRUE;
-        break;    /* found semaphore */
-      }
-    }
-    p_find = p_find->p_pptr;  /* repate process in parent */
-  }
-  /* If semaphore is null at this point, then no semaphore has been found for the process */
-  return sem;
-}
-
+  struct sys_allocate_semaphore_set_args *uap = v;
+  char kname[MAX_NAME_LENGTH];
+  u_int64_t key;
+  int length;
+  int knsems;
 
+  length = 0;
 
+  COPYNAME(kname, uap, length);
+  NAMECHECK(kname, length, key, ENAMETOOLONG);
 
+  knsems = SCARG(uap, nsems);
+  if (knsems < 1 || knsems > SEM_NSEMS_MAX)
+    return EINVAL;
+  return create_semaphore(p, kname, key, SEM_TYPE_SEMAPHORE, knsems,
+                          SCARG(uap, initial_count), SEM_SCOPE_PROC, 0, 0, NULL);
+}
 
+/*
+ * Semaphore down on one slot of a set: 299
+ */
+int
+sys_down_semaphore_index (struct proc *p, void *v, register_t *retval)
+{
+  struct sys_down_semaphore_index_args *uap = v;
+  semaphore_t *sem;
+  char kname[MAX_NAME_LENGTH];
+  u_int64_t key;
+  int length;
+  int kindex;
 
+  length = 0;
 
+  COPYNAME(kname, uap, length);
+  NAMECHECK(kname, length, key, ENOENT);
+  sem = find_semaphore(p, kname, key);
+  if(sem == NULL)
+    return ENOENT;
+  if (sem->scope == SEM_SCOPE_GLOBAL && sem_access(p->p_ucred, sem, S_IWUSR) != 0)
+    return EACCES;
+  if (sem->type != SEM_TYPE_SEMAPHORE)
+    return EINVAL;          /* name belongs to a barrier */
+
+  kindex = SCARG(uap, index);
+  if (kindex < 0 || kindex >= sem->nsems)
+    return EINVAL;          /* no such slot */
+  return sem_down(p, sem, kindex);
+}
 
+/*
+ * Semaphore up on one slot of a set: 300
+ */
+int
+sys_up_semaphore_index (struct proc *p, void *v, register_t *retval)
+{
+  struct sys_up_semaphore_index_args *uap = v;
+  semaphore_t *sem;
+  char kname[MAX_NAME_LENGTH];
+  u_int64_t key;
+  int length;
+  int kindex;
 
+  length = 0;
 
+  COPYNAME(kname, uap, length);
+  NAMECHECK(kname, length, key, ENOENT);
+  sem = find_semaphore(p, kname, key);
+  if(sem == NULL)
+    return ENOENT;
+  if (sem->scope == SEM_SCOPE_GLOBAL && sem_access(p->p_ucred, sem, S_IWUSR) != 0)
+    return EACCES;
+  if (sem->type != SEM_TYPE_SEMAPHORE)
+    return EINVAL;          /* name belongs to a barrier */
+
+  kindex = SCARG(uap, index);
+  if (kindex < 0 || kindex >= sem->nsems)
+    return EINVAL;          /* no such slot */
+  return sem_up(p, sem, kindex);
+}
 
+/*
+ * Create a barrier for parties processes: 301
+ */
+int
+sys_allocate_barrier (struct proc *p, void *v, register_t *retval)
+{
+  struct sys_allocate_barrier_args *uap = v;
+  char kname[MAX_NAME_LENGTH];
+  u_int64_t key;
+  int length;
 
+  length = 0;
 
+  COPYNAME(kname, uap, length);
+  NAMECHECK(kname, length, key, ENAMETOOLONG);
+  if (SCARG(uap, parties) < 1)
+    return EINVAL;
+  return create_semaphore(p, kname, key, SEM_TYPE_BARRIER, 1,
+                          SCARG(uap, parties), SEM_SCOPE_PROC, 0, 0, NULL);
+}
 
+/*
+ * Arrive at a barrier and wait for the rest of the phase: 302
+ *
+ * Every process of the phase gets the phase's generation number back in
+ * retval.  Each sleeper waits on its own node, so a process that has
+ * already moved on to the next phase queues a fresh node that the
+ * previous release cannot touch.
+ */
+int
+sys_wait_barrier (struct proc *p, void *v, register_t *retval)
+{
+  struct sys_wait_barrier_args *uap = v;
+  semaphore_t *sem;
+  struct sem_slot *slot;
+  char kname[MAX_NAME_LENGTH];
+  u_int64_t key;
+  int length;
+
+  length = 0;
+
+  COPYNAME(kname, uap, length);
+  NAMECHECK(kname, length, key, ENOENT);
+  sem = find_semaphore(p, kname, key);
+  if(sem == NULL)
+    return ENOENT;
+  if (sem->type != SEM_TYPE_BARRIER)
+    return EINVAL;
+
+  slot = &sem->slot[0];
+  simple_lock(&sem->interlock);
+  *retval = sem->generation;
+  --slot->count;
+  if (slot->count > 0)
+    return sem_sleep(p, sem, slot, "waiting on barrier");
+
+  /* Last arrival: rearm for the next phase and release this one */
+  slot->count = sem->parties;
+  ++sem->generation;
+  sem_wakeall(sem, slot, P_NODE_POSTED);
+  simple_unlock(&sem->interlock);
+  return(0);
+}
+
+/*
+ * Down whichever of several semaphores is available first: 303
+ *
+ * Returns the index of the one acquired in retval.  When none is free the
+ * process queues a node on every one of them, charging each count as a
+ * down would, and sleeps once; the first up or free to reach any node
+ * cancels the rest (see sem_post()).  SEM_BARGE semaphores are not charged
+ * and hand their next unit straight to such a node (see sem_up_barge()).
+ */
+int
+sys_down_semaphore_any (struct proc *p, void *v, register_t *retval)
+{
+  struct sys_down_semaphore_any_args *uap = v;
+  char *unames[SEM_ANY_MAX];
+  char knames[SEM_ANY_MAX][MAX_NAME_LENGTH];
+  u_int64_t keys[SEM_ANY_MAX];
+  semaphore_t *sems[SEM_ANY_MAX];
+  struct p_node *nodes, *np;
+  int length;
+  int knnames;
+  int flag;
+  int i;
+
+  knnames = SCARG(uap, nnames);
+  if (knnames < 1 || knnames > SEM_ANY_MAX)
+    return EINVAL;
+  if (copyin(SCARG(uap, names), unames, knnames * sizeof(char *)) != 0)
+    return EFAULT;
+
+  /* Copy every name in first: copyinstr may sleep, lookups must not be stale */
+  for (i = 0; i < knnames; i++)
+  {
+    length = 0;
+    if (copyinstr(unames[i], &knames[i], MAX_NAME_LENGTH, &length) == EFAULT)
+      return EFAULT;
+    NAMECHECK(knames[i], length, keys[i], ENOENT);
+  }
+  for (i = 0; i < knnames; i++)
+  {
+    sems[i] = find_semaphore(p, knames[i], keys[i]);
+    if (sems[i] == NULL)
+      return ENOENT;
+    if (sems[i]->scope == SEM_SCOPE_GLOBAL &&
+        sem_access(p->p_ucred, sems[i], S_IWUSR) != 0)
+      return EACCES;
+    if (sems[i]->type != SEM_TYPE_SEMAPHORE || (sems[i]->flags & SEM_MUTEX))
+      return EINVAL;        /* barrier, or a mutex that would need an owner per node */
+  }
+
+  /* Take the first free one without queueing anywhere */
+  for (i = 0; i < knnames; i++)
+  {
+    simple_lock(&sems[i]->interlock);
+    if (sems[i]->slot[0].count > 0)
+    {
+      --sems[i]->slot[0].count;
+      simple_unlock(&sems[i]->interlock);
+      *retval = i;
+      return(0);
+    }
+    simple_unlock(&sems[i]->interlock);
+  }
+
+  nodes = (struct p_node*) malloc(knnames * sizeof(struct p_node), M_PROC, M_NOWAIT);
+  if (nodes == NULL)
+    return ENOMEM;
+  nodes[0].nany = knnames;
+  for (i = 0; i < knnames; i++)
+  {
+    np = &nodes[i];
+    np->p = p;
+    np->state = P_NODE_WAITING;
+    np->sem = sems[i];
+    np->group = nodes;
+    np->passed = 0;
+    simple_lock(&sems[i]->interlock);
+    if ((sems[i]->flags & SEM_BARGE) == 0)
+      --sems[i]->slot[0].count;
+    SIMPLEQ_INSERT_TAIL(&sems[i]->slot[0].p_head, np, p_next);
+    simple_unlock(&sems[i]->interlock);
+  }
+
+  while (nodes[0].state == P_NODE_WAITING)
+    tsleep((void*) nodes, p->p_priority, "waiting on semaphores", 0);
+
+  *retval = nodes[0].which;
+  flag = (nodes[0].state == P_NODE_GONE) ? ENOENT : 0;
+  free(nodes, M_PROC);
+  return(flag);
+}
+
+/*
+ * Create semaphore with SEM_* behaviour flags: 304
+ */
+int
+sys_allocate_semaphore_flags (struct proc *p, void *v, register_t *retval)
+{
+  struct sys_allocate_semaphore_flags_args *uap = v;
+  char kname[MAX_NAME_LENGTH];
+  u_int64_t key;
+  int length;
+  int kflags;
+
+  length = 0;
+
+  COPYNAME(kname, uap, length);
+  NAMECHECK(kname, length, key, ENAMETOOLONG);
+
+  kflags = SCARG(uap, flags);
+  if ((kflags & ~SEM_FLAGS) != 0)
+    return EINVAL;
+  if ((kflags & SEM_MUTEX) && SCARG(uap, initial_count) > 1)
+    return EINVAL;          /* a mutex is free (1) or held by its creator (0) */
+  return create_semaphore(p, kname, key, SEM_TYPE_SEMAPHORE, 1,
+                          SCARG(uap, initial_count), SEM_SCOPE_PROC, 0, kflags,
+                          NULL);
+}
+
+/*
+ * Create channel of capacity records of up to msgsize bytes: 305
+ */
+int
+sys_allocate_channel (struct proc *p, void *v, register_t *retval)
+{
+  struct sys_allocate_channel_args *uap = v;
+  char kname[MAX_NAME_LENGTH];
+  struct sem_ring *ring;
+  u_int64_t key;
+  int length;
+  int kcapacity, kmsgsize;
+  int flag;
+
+  length = 0;
+
+  COPYNAME(kname, uap, length);
+  NAMECHECK(kname, length, key, ENAMETOOLONG);
+
+  kcapacity = SCARG(uap, capacity);
+  kmsgsize = SCARG(uap, msgsize);
+  if (kcapacity < 1 || kcapacity > SEM_CHAN_MAX || kmsgsize < 1 || kmsgsize > SEM_MSG_MAX)
+    return EINVAL;
+  ring = (struct sem_ring*) malloc(SEM_RING_SIZE(kcapacity, kmsgsize), M_PROC, M_NOWAIT);
+  if (ring == NULL)
+    return ENOMEM;
+  ring->capacity = kcapacity;
+  ring->msgsize = kmsgsize;
+  ring->head = ring->tail = ring->used = 0;
+
+  /* slot[SEM_CHAN_SPACE] starts at capacity, slot[SEM_CHAN_ITEMS] at 0 */
+  flag = create_semaphore(p, kname, key, SEM_TYPE_CHANNEL, 2, kcapacity,
+                          SEM_SCOPE_PROC, 0, 0, ring);
+  if (flag != 0)
+    free(ring, M_PROC);
+  return(flag);
+}
+
+/*
+ * Send message to channel, sleeping while it is full: 306
+ */
+int
+sys_channel_send (struct proc *p, void *v, register_t *retval)
+{
+  struct sys_channel_send_args *uap = v;
+  char kname[MAX_NAME_LENGTH];
+  char kmsg[SEM_MSG_MAX];
+  semaphore_t *sem;
+  u_int64_t key;
+  int length;
+  int klen;
+  int flag;
+
+  length = 0;
+  klen = SCARG(uap, len);
+  if (klen < 0 || klen > SEM_MSG_MAX)
+    return EMSGSIZE;
+
+  /* Copy in first: copyin may sleep, the lookup must not be stale */
+  COPYNAME(kname, uap, length);
+  NAMECHECK(kname, length, key, ENOENT);
+  if (copyin(SCARG(uap, msg), kmsg, klen) != 0)
+    return EFAULT;
+
+  sem = find_semaphore(p, kname, key);
+  if (sem == NULL)
+    return ENOENT;
+  if (sem->type != SEM_TYPE_CHANNEL)
+    return EINVAL;
+  if (klen > sem->ring->msgsize)
+    return EMSGSIZE;
+
+  ++sem->refs;                               /* sem may be freed while we sleep */
+  flag = sem_down(p, sem, SEM_CHAN_SPACE);   /* reserve a record */
+  if (flag == 0 && sem->dead)
+    flag = ENOENT;                           /* freed after we were posted */
+  if (flag == 0)
+  {
+    simple_lock(&sem->interlock);
+    chan_put(sem->ring, kmsg, klen);
+    simple_unlock(&sem->interlock);
+    sem_up(p, sem, SEM_CHAN_ITEMS);          /* hand it to a receiver */
+  }
+  sem_unref(sem);
+  return(flag);
+}
+
+/*
+ * Receive message from channel, sleeping while it is empty: 307
+ *
+ * len must hold the channel's msgsize; the message length goes in retval.
+ */
+int
+sys_channel_receive (struct proc *p, void *v, register_t *retval)
+{
+  struct sys_channel_receive_args *uap = v;
+  char kname[MAX_NAME_LENGTH];
+  char kmsg[SEM_MSG_MAX];
+  semaphore_t *sem;
+  u_int64_t key;
+  int length;
+  int klen;
+  int flag;
+
+  length = 0;
+
+  COPYNAME(kname, uap, length);
+  NAMECHECK(kname, length, key, ENOENT);
+  sem = find_semaphore(p, kname, key);
+  if (sem == NULL)
+    return ENOENT;
+  if (sem->type != SEM_TYPE_CHANNEL)
+    return EINVAL;
+  if (SCARG(uap, len) < sem->ring->msgsize)
+    return EMSGSIZE;
+  if (!uvm_useracc((caddr_t)SCARG(uap, msg), sem->ring->msgsize, B_WRITE))
+    return EFAULT;                           /* before one is dequeued and lost */
+
+  ++sem->refs;                               /* sem may be freed while we sleep */
+  flag = sem_down(p, sem, SEM_CHAN_ITEMS);   /* wait for a message */
+  if (flag == 0 && sem->dead)
+    flag = ENOENT;                           /* freed after we were posted */
+  if (flag != 0)
+  {
+    sem_unref(sem);
+    return(flag);
+  }
+  simple_lock(&sem->interlock);
+  klen = chan_get(sem->ring, kmsg);
+  simple_unlock(&sem->interlock);
+  sem_up(p, sem, SEM_CHAN_SPACE);
+  sem_unref(sem);
+
+  /* sem may go away while copyout sleeps; we are done with it */
+  if (copyout(kmsg, SCARG(uap, msg), klen) != 0)
+    return EFAULT;
+  *retval = klen;
+  return(0);
+}
+
+/*
+ * Send nmsgs messages packed back to back in msgs, lens[i] bytes each: 308
+ *
+ * Sleeps for room as needed.  Every record free at the time is reserved
+ * and filled under one interlock hold.  The number sent goes in retval; a
+ * channel freed part way through fails the call only if none were sent.
+ */
+int
+sys_channel_send_batch (struct proc *p, void *v, register_t *retval)
+{
+  struct sys_channel_send_batch_args *uap = v;
+  char kname[MAX_NAME_LENGTH];
+  int klens[SEM_BATCH_MAX];
+  semaphore_t *sem;
+  struct sem_slot *space;
+  char *kmsgs, *msg;
+  u_int64_t key;
+  int length;
+  int knmsgs, total;
+  int flag;
+  int i, j;
+
+  length = 0;
+  knmsgs = SCARG(uap, nmsgs);
+  if (knmsgs < 1 || knmsgs > SEM_BATCH_MAX)
+    return EINVAL;
+
+  COPYNAME(kname, uap, length);
+  NAMECHECK(kname, length, key, ENOENT);
+  if (copyin(SCARG(uap, lens), klens, knmsgs * sizeof(int)) != 0)
+    return EFAULT;
+  total = 0;
+  for (i = 0; i < knmsgs; i++)
+  {
+    if (klens[i] < 0 || klens[i] > SEM_MSG_MAX)
+      return EMSGSIZE;
+    total += klens[i];
+  }
+  kmsgs = (char*) malloc(total + 1, M_TEMP, M_WAITOK);
+  if (copyin(SCARG(uap, msgs), kmsgs, total) != 0)
+  {
+    free(kmsgs, M_TEMP);
+    return EFAULT;
+  }
+
+  flag = 0;
+  sem = find_semaphore(p, kname, key);
+  if (sem == NULL)
+    flag = ENOENT;
+  else if (sem->type != SEM_TYPE_CHANNEL)
+    flag = EINVAL;
+  else
+    for (i = 0; i < knmsgs; i++)
+      if (klens[i] > sem->ring->msgsize)
+        flag = EMSGSIZE;
+  if (flag != 0)
+  {
+    free(kmsgs, M_TEMP);
+    return(flag);
+  }
+
+  space = &sem->slot[SEM_CHAN_SPACE];
+  msg = kmsgs;
+  ++sem->refs;        /* sem may be freed while we sleep */
+  for (i = 0; i < knmsgs; )
+  {
+    flag = sem_down(p, sem, SEM_CHAN_SPACE);
+    if (flag == 0 && sem->dead)
+      flag = ENOENT;  /* freed after we were posted */
+    if (flag != 0)
+      break;          /* channel freed under us */
+    simple_lock(&sem->interlock);
+    j = i;
+    do
+    {
+      chan_put(sem->ring, msg, klens[i]);
+      msg += klens[i++];
+    } while (i < knmsgs && sem_trydown(space));
+    simple_unlock(&sem->interlock);
+    for (; j < i; j++)
+      sem_up(p, sem, SEM_CHAN_ITEMS);
+  }
+  sem_unref(sem);
+  free(kmsgs, M_TEMP);
+  if (i > 0)
+    flag = 0;         /* report what was sent, as write(2) does */
+  *retval = i;
+  return(flag);
+}
+
+/*
+ * Receive up to nmsgs messages into msgs, packed back to back within len
+ * bytes, and their lengths into lens: 309
+ *
+ * Sleeps only for the first; the rest are what is already queued.  The
+ * number received goes in retval.
+ */
+int
+sys_channel_receive_batch (struct proc *p, void *v, register_t *retval)
+{
+  struct sys_channel_receive_batch_args *uap = v;
+  char kname[MAX_NAME_LENGTH];
+  int klens[SEM_BATCH_MAX];
+  semaphore_t *sem;
+  struct sem_slot *items;
+  char *kmsgs;
+  u_int64_t key;
+  int length;
+  int knmsgs, klen, msgsize, off;
+  int flag;
+  int i, j;
+
+  length = 0;
+  knmsgs = SCARG(uap, nmsgs);
+  if (knmsgs < 1 || knmsgs > SEM_BATCH_MAX)
+    return EINVAL;
+  klen = SCARG(uap, len);
+  if (klen > knmsgs * SEM_MSG_MAX)
+    klen = knmsgs * SEM_MSG_MAX;   /* never more than nmsgs full records */
+
+  COPYNAME(kname, uap, length);
+  NAMECHECK(kname, length, key, ENOENT);
+  sem = find_semaphore(p, kname, key);
+  if (sem == NULL)
+    return ENOENT;
+  if (sem->type != SEM_TYPE_CHANNEL)
+    return EINVAL;
+  msgsize = sem->ring->msgsize;
+  if (klen < msgsize)
+    return EMSGSIZE;
+  /* Messages dequeued cannot be put back, so fault now rather than after */
+  if (!uvm_useracc((caddr_t)SCARG(uap, msgs), klen, B_WRITE) ||
+      !uvm_useracc((caddr_t)SCARG(uap, lens), knmsgs * sizeof(int), B_WRITE))
+    return EFAULT;
+  kmsgs = (char*) malloc(klen, M_TEMP, M_NOWAIT);
+  if (kmsgs == NULL)
+    return ENOMEM;
+
+  ++sem->refs;        /* sem may be freed while we sleep */
+  flag = sem_down(p, sem, SEM_CHAN_ITEMS);
+  if (flag == 0 && sem->dead)
+    flag = ENOENT;    /* freed after we were posted */
+  if (flag != 0)
+  {
+    sem_unref(sem);
+    free(kmsgs, M_TEMP);
+    return(flag);
+  }
+  items = &sem->slot[SEM_CHAN_ITEMS];
+  off = 0;
+  i = 0;
+  simple_lock(&sem->interlock);
+  do
+  {
+    klens[i] = chan_get(sem->ring, kmsgs + off);
+    off += klens[i++];
+  } while (i < knmsgs && off + msgsize <= klen && sem_trydown(items));
+  simple_unlock(&sem->interlock);
+  for (j = 0; j < i; j++)
+    sem_up(p, sem, SEM_CHAN_SPACE);
+  sem_unref(sem);
+
+  if (copyout(kmsgs, SCARG(uap, msgs), off) != 0 ||
+      copyout(klens, SCARG(uap, lens), i * sizeof(int)) != 0)
+    flag = EFAULT;
+  free(kmsgs, M_TEMP);
+  *retval = i;
+  return(flag);
+}
+
+/*
+ * Create condition variable: 310
+ */
+int
+sys_allocate_condition (struct proc *p, void *v, register_t *retval)
+{
+  struct sys_allocate_condition_args *uap = v;
+  char kname[MAX_NAME_LENGTH];
+  u_int64_t key;
+  int length;
+
+  length = 0;
+
+  COPYNAME(kname, uap, length);
+  NAMECHECK(kname, length, key, ENAMETOOLONG);
+  return create_semaphore(p, kname, key, SEM_TYPE_COND, 1, 0, SEM_SCOPE_PROC,
+                          0, 0, NULL);
+}
+
+/*
+ * Wait on condition name, releasing semaphore mutex while asleep: 311
+ *
+ * The caller must hold mutex.  It is upped with the condition's interlock
+ * held and the process queued, so no signal can fall between the two, and
+ * downed again on wakeup; mutex is looked up again by name for that, since
+ * it may have been freed meanwhile.
+ */
+int
+sys_wait_condition (struct proc *p, void *v, register_t *retval)
+{
+  struct sys_wait_condition_args *uap = v;
+  char kname[MAX_NAME_LENGTH];
+  char kmutex[MAX_NAME_LENGTH];
+  semaphore_t *cond, *mutex;
+  u_int64_t key, mkey;
+  int length;
+  int flag, mflag;
+
+  length = 0;
+
+  COPYNAME(kname, uap, length);
+  NAMECHECK(kname, length, key, ENOENT);
+  length = 0;
+  if (copyinstr(SCARG(uap, mutex), &kmutex, MAX_NAME_LENGTH, &length) == EFAULT)
+    return EFAULT;
+  NAMECHECK(kmutex, length, mkey, ENOENT);
+
+  cond = find_semaphore(p, kname, key);
+  mutex = find_semaphore(p, kmutex, mkey);
+  if (cond == NULL || mutex == NULL)
+    return ENOENT;
+  if (cond->type != SEM_TYPE_COND || mutex->type != SEM_TYPE_SEMAPHORE)
+    return EINVAL;
+  if (mutex->scope == SEM_SCOPE_GLOBAL && sem_access(p->p_ucred, mutex, S_IWUSR) != 0)
+    return EACCES;
+  if ((mutex->flags & SEM_MUTEX) ? mutex->holder != p : mutex->slot[0].count > 0)
+    return EPERM;           /* not held, by us or anyone */
+
+  simple_lock(&cond->interlock);
+  --cond->slot[0].count;
+  sem_up(p, mutex, 0);
+  flag = sem_sleep(p, cond, &cond->slot[0], "waiting on condition");
+
+  /* Relock whatever the outcome, as pthread_cond_wait() does */
+  mutex = find_semaphore(p, kmutex, mkey);
+  if (mutex == NULL)
+    return ENOENT;
+  mflag = sem_down(p, mutex, 0);
+  return (flag != 0 ? flag : mflag);
+}
+
+/*
+ * Wake the longest waiter on condition name, if any: 312
+ *
+ * A signal with nobody waiting is lost.  retval is the number woken.
+ */
+int
+sys_signal_condition (struct proc *p, void *v, register_t *retval)
+{
+  struct sys_signal_condition_args *uap = v;
+  char kname[MAX_NAME_LENGTH];
+  semaphore_t *cond;
+  u_int64_t key;
+  int length;
+
+  length = 0;
+
+  COPYNAME(kname, uap, length);
+  NAMECHECK(kname, length, key, ENOENT);
+  cond = find_semaphore(p, kname, key);
+  if (cond == NULL)
+    return ENOENT;
+  if (cond->type != SEM_TYPE_COND)
+    return EINVAL;
+
+  /* An up with the count at 0 or above would bank a wakeup */
+  *retval = (cond->slot[0].count < 0);
+  if (*retval)
+    sem_up(p, cond, 0);
+  return(0);
+}
+
+/*
+ * Wake every waiter on condition name in one pass: 313
+ *
+ * retval is the number woken.
+ */
+int
+sys_broadcast_condition (struct proc *p, void *v, register_t *retval)
+{
+  struct sys_broadcast_condition_args *uap = v;
+  char kname[MAX_NAME_LENGTH];
+  semaphore_t *cond;
+  u_int64_t key;
+  int length;
+
+  length = 0;
+
+  COPYNAME(kname, uap, length);
+  NAMECHECK(kname, length, key, ENOENT);
+  cond = find_semaphore(p, kname, key);
+  if (cond == NULL)
+    return ENOENT;
+  if (cond->type != SEM_TYPE_COND)
+    return EINVAL;
+
+  simple_lock(&cond->interlock);
+  *retval = -cond->slot[0].count;
+  cond->slot[0].count = 0;
+  sem_wakeall(cond, &cond->slot[0], P_NODE_POSTED);   /* no wait-for-any nodes here */
+  simple_unlock(&cond->interlock);
+  return(0);
+}
+
+/* Get semaphore with presedence according to creation - traverse the process tree bottom-up */
+semaphore_t* find_semaphore(struct proc *p, char *kname, u_int64_t key)
+{
+  semaphore_t *sem;
+  struct proc *p_find;      /* Process to search through */
+  int breakloop;            /* flag to exit */
+
+  /* Global names bypass the family tree altogether */
+  if (GLOBALNAME(kname))
+    return find_global_semaphore(kname, key);
+
+  p_find = p;             /* Start with current process */
+  sem = NULL;
+  breakloop = FALSE;
+
+  /* Go through all the semaphores I created */
+  while((LIST_EMPTY(&p_find->semaphores) == FALSE || p_find->inherited == TRUE) && breakloop == FALSE)      
+  {  
+    /* Until I get to a process that neither has created semaphore or inherited them */
+    LIST_FOREACH(sem, &p_find->semaphores, s_next)
+    {
+      /* Search through the process's semaphore list for such name */
+      if(SAMENAME(sem, kname, key) && sem->owner == p_find)
+      {
+        breakloop = TRUE;
+        break;    /* found semaphore */
+      }
+    }
+    p_find = p_find->p_pptr;  /* repate process in parent */
+  }
+
+  /* Not in the family tree: fall back on the process group namespace */
+  if (sem == NULL && sem_npgrp > 0)
+    sem = find_pgrp_semaphore(p->p_pgrp, kname, key);
+
+  /* If semaphore is null at this point, then no semaphore has been found for the process */
+  return sem;
+}
+
+/* Get semaphore attached to process group pg - single hash probe */
+semaphore_t* find_pgrp_semaphore(struct pgrp *pg, char *kname, u_int64_t key)
+{
+  semaphore_t *sem;
+
+  LIST_FOREACH(sem, &sem_pgrphash[sem_hash(pg->pg_id, key)], s_next)
+    if (sem->pgrp == pg && SAMENAME(sem, kname, key))
+      return sem;
+  return NULL;
+}
+
+/* Get semaphore from the global namespace - single hash probe */
+semaphore_t* find_global_semaphore(char *kname, u_int64_t key)
+{
+  semaphore_t *sem;
+
+  LIST_FOREACH(sem, &sem_globalhash[sem_hash(0, key)], s_next)
+    if (SAMENAME(sem, kname, key))
+      return sem;
+  return NULL;
+}
 
+/* 64-bit FNV-1a key of the first length bytes of kname */
+u_int64_t sem_key(char *kname, int length)
+{
+  u_int64_t h;
+
+  h = 0xcbf29ce484222325ULL;
+  while (length-- > 0)
+  {
+    h ^= (u_char)*kname++;
+    h *= 0x100000001b3ULL;
+  }
+  return h;
+}
+
+/* Bucket of (id, key) in the group (id = pgid) or global (id = 0) namespace */
+u_int sem_hash(pid_t id, u_int64_t key)
+{
+  u_int h;
+
+  h = (u_int)(key ^ (key >> 32)) ^ ((u_int)id * 0x9e3779b1U);
+  return (h & (SEM_HASH_SIZE - 1));
+}
+
+/* Allocate semaphore kname for p in namespace scope and link it in */
+int create_semaphore(struct proc *p, char *kname, u_int64_t key, int type,
+    int nsems, int kcount, int scope, int mode, int flags,
+    struct sem_ring *ring)
+{
+  semaphore_t *sem;
+  size_t length;
+  int i;
+
+  if (GLOBALNAME(kname) != (scope == SEM_SCOPE_GLOBAL))
+    return EINVAL;     /* '/' names are reserved for the global namespace */
+  if (scope == SEM_SCOPE_GLOBAL)
+  {
+    if (find_global_semaphore(kname, key) != NULL)
+      return EEXIST;   /* name taken system wide */
+  }
+  else if (scope == SEM_SCOPE_PGRP)
+  {
+    if (find_pgrp_semaphore(p->p_pgrp, kname, key) != NULL)
+      return EEXIST;   /* group already has semaphore with that name */
+  }
+  else
+  {
+    LIST_FOREACH(sem, &(p->semaphores), s_next)
+      if (SAMENAME(sem, kname, key) && sem->owner == p)
+        return EEXIST;   /* process owns semaphore with that name */
+  }
+
+  if (kcount < 0)
+    return EDOM;            /* out of range */
+  
+  /* allocate memeory for semaphore right now */
+  sem = (struct semaphore*) malloc(SEM_SIZE(nsems), M_PROC, M_NOWAIT);
+  if (sem == NULL)
+    return ENOMEM;     /* not enough memeory */
+
+  /* initialize semaphore */
+  if (copystr(kname, &sem->name, MAX_NAME_LENGTH, &length) == EFAULT)
+  {     
+    /* something bad happaned. abort*/                  
+    free(sem, M_PROC);        
+    return EFAULT;
+  }
+  sem->key = key;
+  sem->type = type;
+  sem->scope = scope;
+  sem->flags = flags;
+  sem->nsems = nsems;
+  sem->parties = kcount;
+  sem->generation = 0;
+  for (i = 0; i < nsems; i++)
+  {
+    sem->slot[i].count = kcount;
+    SIMPLEQ_INIT(&(sem->slot[i].p_head));
+  }
+  sem->pgrp = NULL;
+  sem->holder = NULL;
+  sem->ring = ring;
+  sem->refs = 0;
+  sem->dead = FALSE;
+  if (type == SEM_TYPE_CHANNEL)
+    sem->slot[SEM_CHAN_ITEMS].count = 0;   /* kcount is the capacity */
+  SLIST_INIT(&sem->klist);
+  simple_lock_init(&sem->interlock);
+  if ((flags & SEM_MUTEX) && kcount == 0)
+    sem_take(p, sem, &sem->slot[0]);   /* created locked */
+  if (scope == SEM_SCOPE_GLOBAL)
+  {
+    /* persists until freed by its creator or root */
+    sem->owner = NULL;
+    sem->uid = p->p_ucred->cr_uid;
+    sem->gid = p->p_ucred->cr_gid;
+    sem->mode = mode & ACCESSPERMS;
+    LIST_INSERT_HEAD(&sem_globalhash[sem_hash(0, key)], sem, s_next);
+  }
+  else if (scope == SEM_SCOPE_PGRP)
+  {
+    /* outlives its creator: released by free or when the group dies */
+    sem->owner = NULL;
+    sem->pgrp = p->p_pgrp;
+    LIST_INSERT_HEAD(&sem_pgrphash[sem_hash(sem->pgrp->pg_id, key)], sem, s_next);
+    ++sem_npgrp;
+  }
+  else
+  {
+    sem->owner = p;
+    LIST_INSERT_HEAD(&p->semaphores, sem, s_next);
+  }
+  return(0);
+}
+
+/* Wake every waiter with ENOENT, unlink semaphore and release its memory */
+void destroy_semaphore(semaphore_t *sem)
+{
+  struct proc *hp;
+  int i;
+
+  hp = sem_give(sem);         /* NULL unless a held SEM_MUTEX */
+  for (i = 0; i < sem->nsems; i++)
+    sem_wakeall(sem, &sem->slot[i], P_NODE_GONE);
+  if (!SLIST_EMPTY(&sem->klist))
+  {
+    KNOTE(&sem->klist, SEM_KNOTE_GONE);   /* watchers see EOF */
+  }
+  if (sem->scope == SEM_SCOPE_PGRP)
+    --sem_npgrp;
+  LIST_REMOVE(sem, s_next);   /* Remove from process list or hash chain */
+  sem->dead = TRUE;
+  if (sem->refs == 0)
+    sem_release(sem);         /* else the last channel call using it does */
+  if (hp != NULL)
+    sem_unboost(hp);          /* its waiters are gone */
+}
+
+/*
+ * Drop a channel call's reference.  A sender or receiver posted by up may
+ * only run again after the channel was freed, so it holds sem from before
+ * its down until it is done with the ring; destroy leaves the memory to it.
+ */
+void sem_unref(semaphore_t *sem)
+{
+  if (--sem->refs == 0 && sem->dead)
+    sem_release(sem);
+}
+
+/* Release the memory of a destroyed semaphore */
+void sem_release(semaphore_t *sem)
+{
+  if (sem->ring != NULL)
+    free(sem->ring, M_PROC);  /* queued messages go with it */
+  free(sem, M_PROC);          /* Free memory */
+}
+
+/* Down slot idx of sem, sleeping until it is posted or sem is destroyed */
+int sem_down(struct proc *p, semaphore_t *sem, int idx)
+{
+  struct sem_slot *slot;
+
+  slot = &sem->slot[idx];
+  simple_lock(&sem->interlock);  /* Lock interlock */
+  if (sem->flags & SEM_MUTEX)
+  {
+    if (sem->holder == p)
+    {
+      simple_unlock(&sem->interlock);
+      return EDEADLK;           /* would wait on ourselves forever */
+    }
+    if (slot->count <= 0 && sem->holder != NULL)
+      sem_boost(sem->holder, p->p_priority);   /* lend it our priority */
+  }
+  if (sem->flags & SEM_BARGE)
+  {
+    /* A free unit goes to whoever asks first, sleepers or not */
+    if (slot->count == 0)
+      return sem_sleep(p, sem, slot, "waiting on semaphore");
+    --slot->count;
+  }
+  else
+  {
+    --slot->count;
+    if(slot->count < 0)
+      return sem_sleep(p, sem, slot, "waiting on semaphore");
+  }
+  if (sem->flags & SEM_MUTEX)
+    sem_take(p, sem, slot);
+  simple_unlock(&sem->interlock);      /* Unlock interlock */
+  return(0);
+}
+
+/*
+ * Queue p on slot, whose count the caller has already charged for it (unless
+ * sem barges), drop sem's lock and sleep until a waker dequeues us.  Returns
+ * 0 when posted and ENOENT when sem was destroyed under us.
+ */
+int sem_sleep(struct proc *p, semaphore_t *sem, struct sem_slot *slot, char *wmesg)
+{
+  struct p_node *np;
+  int flag;
+
+  /* create and instantiate node of SIMPLEQ */
+  np = (struct p_node*) malloc (sizeof(struct p_node), M_PROC, M_NOWAIT);
+  if(np == NULL)
+  {
+    if ((sem->flags & SEM_BARGE) == 0)
+      ++slot->count;                                /* undo, we are not waiting */
+    simple_unlock(&sem->interlock);
+    return ENOMEM;
+  }
+  np->p = p;
+  np->state = P_NODE_WAITING;
+  np->sem = sem;
+  np->group = NULL;
+  np->passed = 0;
+  /* 
+   * Make a process sleep on its own node. This way, we wont have to worry
+   * about notifying other processes upon wakeup. Each process will sleep
+   * on a unique "object". The waker unlinks the node and records why it
+   * woke us; the node is ours to free, and once it says P_NODE_GONE the
+   * semaphore may already be freed, so it must not be touched again.
+   */
+  SIMPLEQ_INSERT_TAIL(&slot->p_head, np, p_next);   /* add process to wait queue */
+  simple_unlock(&sem->interlock);       /* release lock before sleeping */
+
+  for (;;)
+  {
+    while (np->state == P_NODE_WAITING)   /* ignore wakeups not meant for us */
+    {
+      if ((sem->flags & SEM_MUTEX) == 0)
+      {
+        tsleep((void*) np, p->p_priority, wmesg, 0);
+        continue;
+      }
+      /*
+       * schedcpu() recomputes the holder's priority every second and
+       * drops what we lent it; lend it again for as long as we wait.
+       * Still waiting means still queued, so sem is still there.
+       */
+      if (tsleep((void*) np, p->p_priority, wmesg, hz) == EWOULDBLOCK &&
+          np->state == P_NODE_WAITING)
+      {
+        simple_lock(&sem->interlock);
+        if (sem->holder != NULL)
+          sem_boost(sem->holder, p->p_priority);
+        simple_unlock(&sem->interlock);
+      }
+    }
+    if (np->state != P_NODE_RETRY)
+      break;
+
+    /*
+     * Barging: we were told a unit came free but are still queued, so the
+     * semaphore is alive; compete for the unit with everyone else.
+     */
+    simple_lock(&sem->interlock);
+    if (slot->count > 0)
+    {
+      --slot->count;
+      sem_unqueue(slot, np);
+      np->state = P_NODE_POSTED;
+      if (sem->flags & SEM_MUTEX)
+        sem_take(p, sem, slot);
+    }
+    else
+    {
+      np->state = P_NODE_WAITING;   /* lost it; sleep again in place */
+      ++np->passed;
+      if ((sem->flags & SEM_MUTEX) && sem->holder != NULL)
+        sem_boost(sem->holder, p->p_priority);
+    }
+    simple_unlock(&sem->interlock);
+  }
+
+  flag = (np->state == P_NODE_GONE) ? ENOENT : 0;
+  free(np, M_PROC);
+  return(flag);
+}
+
+/*
+ * Up slot idx of sem, handing it to the longest waiter if there is one.
+ * EPERM if sem is a SEM_MUTEX that p does not hold.
+ */
+int sem_up(struct proc *p, semaphore_t *sem, int idx)
+{
+  struct sem_slot *slot;
+  struct p_node *np;
+  struct proc *hp;
+
+  slot = &sem->slot[idx];
+  np = NULL;
+  simple_lock(&sem->interlock);  /* Lock interlock */
+  if ((sem->flags & SEM_MUTEX) && sem->holder != p)
+  {
+    simple_unlock(&sem->interlock);
+    return EPERM;                /* only the holder unlocks a mutex */
+  }
+  hp = sem_give(sem);            /* NULL unless SEM_MUTEX */
+  if (sem->flags & SEM_BARGE)
+  {
+    sem_up_barge(sem, slot);
+    if (hp != NULL)
+      sem_unboost(hp);
+    return(0);
+  }
+  ++slot->count;
+
+  if(slot->count <= 0)
+  {
+    /* Signal first process in wait list; it frees its own node */
+    np = SIMPLEQ_FIRST(&slot->p_head);
+    SIMPLEQ_REMOVE_HEAD(&slot->p_head, np, p_next);  /* delete node */
+    np->sem = NULL;
+    if (sem->flags & SEM_MUTEX)
+      sem_take(np->p, sem, slot);   /* ownership passes with the unit */
+  }
+  else if (!SLIST_EMPTY(&sem->klist))
+  {
+    KNOTE(&sem->klist, 0);   /* slot became downable; one test when unwatched */
+  }
+  /* Unlock interlock */
+  simple_unlock(&sem->interlock);
+
+  /* Posted outside the interlock: a wait-for-any may have siblings on sem */
+  if (np != NULL)
+    sem_post(np, P_NODE_POSTED);
+  if (hp != NULL)
+    sem_unboost(hp);
+  return(0);
+}
+
+
+/*
+ * sem_up() for SEM_BARGE, entered with the interlock held.  The unit goes
+ * back into the count and the first sleeper is only woken to compete for
+ * it, so a running process can take it first.  A sleeper that has lost
+ * SEM_BARGE_PASSES times, or a wait-for-any, gets the unit handed to it.
+ */
+void sem_up_barge(semaphore_t *sem, struct sem_slot *slot)
+{
+  struct p_node *np;
 
+  SIMPLEQ_FOREACH(np, &slot->p_head, p_next)
+    if (np->state == P_NODE_WAITING)
+      break;          /* nodes ahead are already woken to retry */
 
+  if (np != NULL && (np->group != NULL || np->passed >= SEM_BARGE_PASSES))
+  {
+    sem_unqueue(slot, np);
+    np->sem = NULL;
+    if (sem->flags & SEM_MUTEX)
+      sem_take(np->p, sem, slot);
+    simple_unlock(&sem->interlock);
+    sem_post(np, P_NODE_POSTED);
+    return;
+  }
+  ++slot->count;
+  if (np != NULL)
+  {
+    np->state = P_NODE_RETRY;   /* stays queued until it wins */
+    wakeup((void *)np);
+  }
+  else if (!SLIST_EMPTY(&sem->klist))
+  {
+    KNOTE(&sem->klist, 0);
+  }
+  simple_unlock(&sem->interlock);
+}
 
+/*
+ * Empty slot's wait queue in one pass, telling every waiter why it woke;
+ * the waiters free their own nodes once they run.
+ */
+void sem_wakeall(semaphore_t *sem, struct sem_slot *slot, int state)
+{
+  struct p_node *np, *next;
+
+  /* Detach the whole queue first: posting a wait-for-any may unqueue siblings */
+  SIMPLEQ_FOREACH(np, &slot->p_head, p_next)
+    np->sem = NULL;
+  np = SIMPLEQ_FIRST(&slot->p_head);
+  SIMPLEQ_INIT(&slot->p_head);
+  while (np != NULL)
+  {
+    next = SIMPLEQ_NEXT(np, p_next);   /* np is not ours after the wakeup */
+    sem_post(np, state);
+    np = next;
+  }
+}
 
+/*
+ * Give a dequeued node its result and wake its process.  A node of a
+ * wait-for-any ends the whole wait: its siblings still queued on other
+ * semaphores are unlinked and the count they charged there is paid back,
+ * so the caller must not hold any semaphore's interlock for such a node.
+ */
+void sem_post(struct p_node *np, int state)
+{
+  struct p_node *head, *sn;
+  int i;
+
+  head = np->group;
+  if (head == NULL)
+  {
+    np->state = state;
+    wakeup((void *)np);
+    return;
+  }
+  if (head->state != P_NODE_WAITING)
+    return;           /* sibling of a wait that already ended in this pass */
+
+  head->state = state;
+  head->which = np - head;
+  for (i = 0; i < head->nany; i++)
+  {
+    sn = &head[i];
+    if (sn->sem == NULL)
+      continue;       /* not queued */
+    simple_lock(&sn->sem->interlock);
+    sem_unqueue(&sn->sem->slot[0], sn);
+    if ((sn->sem->flags & SEM_BARGE) == 0)
+      ++sn->sem->slot[0].count;
+    simple_unlock(&sn->sem->interlock);
+    sn->sem = NULL;
+  }
+  wakeup((void *)head);
+}
+
+/* Unlink np from anywhere in slot's queue; SIMPLEQ only removes the head */
+void sem_unqueue(struct sem_slot *slot, struct p_node *np)
+{
+  struct p_node *q;
+
+  if (SIMPLEQ_FIRST(&slot->p_head) == np)
+  {
+    SIMPLEQ_REMOVE_HEAD(&slot->p_head, np, p_next);
+    return;
+  }
+  SIMPLEQ_FOREACH(q, &slot->p_head, p_next)
+    if (SIMPLEQ_NEXT(q, p_next) == np)
+    {
+      if ((SIMPLEQ_NEXT(q, p_next) = SIMPLEQ_NEXT(np, p_next)) == NULL)
+        slot->p_head.sqh_last = &SIMPLEQ_NEXT(q, p_next);
+      return;
+    }
+}
+
+/*
+ * Down slot of sem only if that needs no sleep, with sem's interlock held;
+ * 1 if taken.  Not for SEM_BARGE or SEM_MUTEX semaphores.
+ */
+int sem_trydown(struct sem_slot *slot)
+{
+  if (slot->count <= 0)
+    return 0;
+  --slot->count;
+  return 1;
+}
+
+/* Copy a message into the record at ring's tail, under the interlock */
+void chan_put(struct sem_ring *ring, char *msg, int len)
+{
+  SEM_RING_LEN(ring, ring->tail) = len;
+  memcpy(SEM_RING_MSG(ring, ring->tail), msg, len);
+  if (++ring->tail == ring->capacity)
+    ring->tail = 0;
+  ++ring->used;
+}
+
+/* Copy the message at ring's head out into msg, under the interlock */
+int chan_get(struct sem_ring *ring, char *msg)
+{
+  int len;
+
+  len = SEM_RING_LEN(ring, ring->head);
+  memcpy(msg, SEM_RING_MSG(ring, ring->head), len);
+  if (++ring->head == ring->capacity)
+    ring->head = 0;
+  --ring->used;
+  return len;
+}
+
+/*
+ * SEM_MUTEX ownership, under sem's interlock.  The holder is lent the best
+ * priority among the processes queued behind it until it unlocks, so a
+ * low priority holder is not kept off the CPU by processes of middling
+ * priority while a high priority one waits for it.
+ */
+void sem_take(struct proc *p, semaphore_t *sem, struct sem_slot *slot)
+{
+  sem->holder = p;
+  LIST_INSERT_HEAD(&p->p_semheld, sem, s_held);
+  sem_boost(p, sem_toppri(slot));
+}
+
+/* Drop sem's holder; returns it for sem_unboost() once the lock is let go */
+struct proc* sem_give(semaphore_t *sem)
+{
+  struct proc *hp;
+
+  hp = sem->holder;
+  if (hp != NULL)
+  {
+    LIST_REMOVE(sem, s_held);
+    sem->holder = NULL;
+  }
+  return hp;
+}
+
+/* Best (lowest) priority of the processes waiting on slot, MAXPRI if none */
+int sem_toppri(struct sem_slot *slot)
+{
+  struct p_node *np;
+  int pri;
+
+  pri = MAXPRI;
+  SIMPLEQ_FOREACH(np, &slot->p_head, p_next)
+    if (np->state == P_NODE_WAITING && np->p->p_priority < pri)
+      pri = np->p->p_priority;
+  return pri;
+}
+
+/*
+ * Lend hp priority pri if it is better than its own.  p_usrpri is what
+ * userret() restores, so the loan outlasts the holder's return to user
+ * mode; a runnable holder moves to the run queue of its new priority.
+ */
+void sem_boost(struct proc *hp, int pri)
+{
+  int s;
+
+  if (hp->p_usrpri > pri)
+    hp->p_usrpri = pri;
+  if (hp->p_priority <= pri)
+    return;
+  s = splstatclock();
+  if (hp != curproc && hp->p_stat == SRUN && (hp->p_flag & P_INMEM))
+  {
+    remrunqueue(hp);
+    hp->p_priority = pri;
+    setrunqueue(hp);
+  }
+  else
+    hp->p_priority = pri;
+  splx(s);
+}
+
+/*
+ * p let go of a mutex: take back the loan, keeping what the mutexes it
+ * still holds lend it.
+ */
+void sem_unboost(struct proc *p)
+{
+  semaphore_t *sem;
+
+  resetpriority(p);
+  LIST_FOREACH(sem, &p->p_semheld, s_held)
+  {
+    simple_lock(&sem->interlock);
+    sem_boost(p, sem_toppri(&sem->slot[0]));
+    simple_unlock(&sem->interlock);
+  }
+}
+
+/*
+ * Called from exit1(): free the semaphores p created, and the semaphores of
+ * its process group if p is the last member still alive.
+ */
+void exit_semaphores(struct proc *p)
+{
+  semaphore_t *sem;
+  struct proc *q;
+
+  /* Unlock the mutexes p holds so their waiters are not stuck behind it */
+  while ((sem = LIST_FIRST(&p->p_semheld)) != NULL)
+    sem_up(p, sem, 0);
+  while ((sem = LIST_FIRST(&p->semaphores)) != NULL)
+    destroy_semaphore(sem);
+
+  if (sem_npgrp == 0)
+    return;
+  LIST_FOREACH(q, &p->p_pgrp->pg_members, p_pglist)
+    if (q != p && (q->p_flag & P_WEXIT) == 0)
+      return;         /* group lives on */
+  pgrp_semaphores(p->p_pgrp);
+}
+
+/*
+ * Called from pgdelete(): free the semaphores of a group going away, whether
+ * its last member was reaped or moved out by setpgid()/setsid().
+ */
+void pgrp_semaphores(struct pgrp *pg)
+{
+  semaphore_t *sem, *next;
+  int i;
+
+  for (i = 0; i < SEM_HASH_SIZE && sem_npgrp > 0; i++)
+  {
+    sem = LIST_FIRST(&sem_pgrphash[i]);
+    while (sem != NULL)
+    {
+      next = LIST_NEXT(sem, s_next);
+      if (sem->pgrp == pg)
+        destroy_semaphore(sem);
+      sem = next;
+    }
+  }
+}
+
+/* Check cred against a global semaphore's mode, after ipcperm() */
+int sem_access(struct ucred *cred, semaphore_t *sem, int mode)
+{
+  if (cred->cr_uid == 0)
+    return 0;           /* superuser */
+
+  if (cred->cr_uid != sem->uid)
+  {
+    mode >>= 3;         /* group bits */
+    if (!groupmember(sem->gid, cred))
+      mode >>= 3;       /* other bits */
+  }
+  return ((sem->mode & mode) == mode ? 0 : EACCES);
+}
+
+/*
+ * EVFILT_SEMAPHORE attach, from kevent() in the registering process:
+ * resolve the name kn_id points to the way down would and hang the note
+ * off the semaphore.
+ */
+int filt_semattach(struct knote *kn)
+{
+  struct proc *p = curproc;
+  semaphore_t *sem;
+  char kname[MAX_NAME_LENGTH];
+  u_int64_t key;
+  int length;
+
+  length = 0;
+
+  if (copyinstr((char *)kn->kn_id, &kname, MAX_NAME_LENGTH, &length) == EFAULT)
+    return EFAULT;
+  NAMECHECK(kname, length, key, ENOENT);
+  sem = find_semaphore(p, kname, key);
+  if (sem == NULL)
+    return ENOENT;
+  if (sem->scope == SEM_SCOPE_GLOBAL && sem_access(p->p_ucred, sem, S_IWUSR) != 0)
+    return EACCES;
+  if ((sem->type != SEM_TYPE_SEMAPHORE && sem->type != SEM_TYPE_CHANNEL) ||
+      kn->kn_sfflags < 0 || kn->kn_sfflags >= sem->nsems)
+    return EINVAL;          /* barrier, or no such slot */
+
+  kn->kn_hook = (caddr_t)sem;
+  SLIST_INSERT_HEAD(&sem->klist, kn, kn_selnext);
+  return(0);
+}
+
+void filt_semdetach(struct knote *kn)
+{
+  semaphore_t *sem = (semaphore_t *)kn->kn_hook;
+
+  if (sem != NULL)          /* NULL once the semaphore is gone */
+    SLIST_REMOVE(&sem->klist, kn, knote, kn_selnext);
+}
+
+/* Downable when the watched slot's count is positive; EOF once destroyed */
+int filt_sem(struct knote *kn, long hint)
+{
+  semaphore_t *sem = (semaphore_t *)kn->kn_hook;
+
+  if (hint == SEM_KNOTE_GONE)
+  {
+    kn->kn_hook = NULL;
+    kn->kn_data = 0;
+    kn->kn_flags |= (EV_EOF | EV_ONESHOT);
+    return(1);
+  }
+  if (sem == NULL)
+    return(1);
+  kn->kn_data = sem->slot[kn->kn_sfflags].count;
+  return (kn->kn_data > 0);
+}
@@ -105,28 +105,6 @@ exit1(p, rv)
 	int rv;
 {
 	struct proc *q, *nq;
-	/***** BEGIN ADDITION by Dawit ************************************/
-
-	/* Might as well reclaim space now before the process get's dismantled */
-	semaphore_t *sem;
-	struct p_node *np;
-
-	LIST_FOREACH(sem, &p->semaphores, s_next)	/* For each semaphore process created */
-	{
-		while(SIMPLEQ_EMPTY(&sem->p_head) == 0)	 /* At least one process is waiting on semaphore */
-		{
-			/* wakeup processes and remove node */
-			np = SIMPLEQ_FIRST(&sem->p_head);
-			wakeup((void *)np->p);
-			SIMPLEQ_REMOVE_HEAD(&sem->p_head, np, p_next);  /* delete node */
-			free(np, M_PROC);                               /* free memory */
-		}
-		LIST_REMOVE(sem, s_next);   /* Remove from process list*/
-		free(sem, M_PROC);          /* Free memory */	
-	}
-
-	/***** END ADDITION by Dawit ************************************/
-
 
 	if (p->p_pid == 1)
 		panic("init died (signal %d, exit %d)",
@@ -140,6 +118,18 @@ exit1(p, rv)
 	 * wake up the parent early to avoid deadlock.
 	 */
 	p->p_flag |= P_WEXIT;
+
+	/***** BEGIN ADDITION by Dawit ************************************/
+
+	/*
+	 * Might as well reclaim space now before the process get's dismantled.
+	 * Not before P_WEXIT: the pool_get() above may sleep, and the group's
+	 * other members must see p as exiting once its semaphores are gone.
+	 */
+	exit_semaphores(p);
+
+	/***** END ADDITION by Dawit ************************************/
+
 	p->p_flag &= ~P_TRACED;
 	if (p->p_flag & P_PPWAIT) {
 		p->p_flag &= ~P_PPWAIT;
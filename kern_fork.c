@@ -257,7 +257,8 @@ fork1(struct proc *p1, int exitsig, int flags, void *stack, size_t stacksize,
 	/***** BEGIN ADDITION by Dawit ************************************/
 
 	LIST_INIT(&p2->semaphores);			
-	if (LIST_EMPTY(&p1->semaphores))	/* nothing to inherit */
+	LIST_INIT(&p2->p_semheld);
+	if (LIST_EMPTY(&p1->semaphores) && !p1->inherited)	/* nothing to inherit */
 		p2->inherited = 0;					
 	else 							  	/* child should inherit parent's semaphores */
 		p2->inherited = 1;					
@@ -0,0 +1,150 @@
+/*
+ * nullbench.c -- fixed cost of a system call, the baseline every
+ * semaphore operation pays before doing any work of its own
+ *
+ * usage: nullbench [-n iterations]
+ *
+ * Runs on a patched kernel:
+ *   null       sys_null(): trap, sysent dispatch and return, nothing else
+ *   null_args  sys_null_args() with six arguments: adds the trap handler's
+ *              copyin of the argument words
+ *   null_str   sys_null_str() on strings of increasing length: adds one
+ *              copyinstr(), as every call taking a semaphore name does
+ *   getppid    the stock kernel's cheapest call, for comparison
+ *
+ * Each result is printed as a single line of key=value pairs, in the
+ * format of sembench.c, e.g.
+ *   bench=null iters=1000000 ns_per_op=312.5 ops_per_sec=3200000
+ * so sembench results can be read net of this overhead.
+ */
+
+#include <sys/types.h>
+#include <sys/syscall.h>
+#include <sys/time.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define MAX_STR_LENGTH	1024	/* sys_null_str() limit, NUL included */
+
+static int iters = 1000000;
+
+static double
+now(void)
+{
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+	return (tv.tv_sec + tv.tv_usec / 1e6);
+}
+
+static void
+fail(const char *what)
+{
+	fprintf(stderr, "nullbench: %s: errno %d\n", what, errno);
+	exit(1);
+}
+
+static void
+report(const char *bench, const char *params, int ops, double secs)
+{
+	printf("bench=%s %siters=%d ns_per_op=%.1f ops_per_sec=%.0f\n", bench,
+	    params, ops, secs * 1e9 / ops, ops / secs);
+	fflush(stdout);
+}
+
+/* (a) no arguments, no work */
+static void
+null(void)
+{
+	double t;
+	int i;
+
+	t = now();
+	for (i = 0; i < iters; i++)
+		if (syscall(SYS_null) == -1)
+			fail("null");
+	t = now() - t;
+	report("null", "", iters, t);
+}
+
+/* (b) six arguments, no work */
+static void
+null_args(void)
+{
+	double t;
+	int i;
+
+	t = now();
+	for (i = 0; i < iters; i++)
+		if (syscall(SYS_null_args, (long)i, (long)i, (long)i, (long)i,
+		    (long)i, (long)i) == -1)
+			fail("null_args");
+	t = now() - t;
+	report("null_args", "args=6 ", iters, t);
+}
+
+/* (c) one copyinstr() of a `len' char string */
+static void
+null_str(int len)
+{
+	char params[64], str[MAX_STR_LENGTH];
+	double t;
+	int i;
+
+	memset(str, 'x', len);
+	str[len] = '\0';
+	t = now();
+	for (i = 0; i < iters; i++)
+		if (syscall(SYS_null_str, str) != len + 1)
+			fail("null_str");
+	t = now() - t;
+	snprintf(params, sizeof(params), "strlen=%d ", len);
+	report("null_str", params, iters, t);
+}
+
+/* (d) the stock kernel's baseline */
+static void
+ppid(void)
+{
+	double t;
+	int i;
+
+	t = now();
+	for (i = 0; i < iters; i++)
+		getppid();
+	t = now() - t;
+	report("getppid", "", iters, t);
+}
+
+int
+main(int argc, char *argv[])
+{
+	/* 31 is the longest semaphore name */
+	static const int lens[] = { 0, 8, 31, 64, 256, MAX_STR_LENGTH - 1 };
+	int ch, i;
+
+	while ((ch = getopt(argc, argv, "n:")) != -1) {
+		switch (ch) {
+		case 'n':
+			iters = atoi(optarg);
+			break;
+		default:
+			fprintf(stderr, "usage: nullbench [-n iterations]\n");
+			return (1);
+		}
+	}
+	if (iters <= 0) {
+		fprintf(stderr, "nullbench: bad arguments\n");
+		return (1);
+	}
+
+	null();
+	null_args();
+	for (i = 0; i < sizeof(lens) / sizeof(lens[0]); i++)
+		null_str(lens[i]);
+	ppid();
+	return (0);
+}
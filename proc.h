@@ -222,6 +222,7 @@ struct	proc {
 
 	int inherited; 		/* Flag to check if process should semaphores from parent */
 	LIST_HEAD(s_list, semaphore) semaphores;	/* Semaphores the process owns */
+	LIST_HEAD(, semaphore) p_semheld;	/* SEM_MUTEX semaphores the process holds */
 	/* Check end of file for semaphore */ 
 
 	/***** END ADDITION by Dawit ************************************/
@@ -441,29 +442,148 @@ void	proc_zap(struct proc *);
 
 #define MAX_NAME_LENGTH 32             /* max sempahore name length, including null terminator */
 
+/* Namespaces a semaphore can be allocated in (sys_allocate_semaphore_scope) */
+#define SEM_SCOPE_PROC 0               /* creator and its descendants */
+#define SEM_SCOPE_PGRP 1               /* every member of the creator's process group */
+#define SEM_SCOPE_GLOBAL 2             /* system wide, names start with '/' (sys_open_semaphore) */
+
+/* Objects that share the semaphore namespace */
+#define SEM_TYPE_SEMAPHORE 0           /* counting semaphore or set: down/up */
+#define SEM_TYPE_BARRIER 1             /* barrier: slot[0].count = arrivals still awaited */
+#define SEM_TYPE_CHANNEL 2             /* bounded message queue, see struct sem_ring */
+#define SEM_TYPE_COND 3                /* condition variable: slot[0].count = -waiters */
+
+/* Behaviour flags (sys_allocate_semaphore_flags) */
+#define SEM_BARGE 0x01                 /* up wakes a sleeper to compete instead of handing off */
+#define SEM_MUTEX 0x02                 /* count 0/1 with an owner that lends it waiters' priority */
+#define SEM_FLAGS (SEM_BARGE | SEM_MUTEX)
+
+#define SEM_BARGE_PASSES 4             /* losses before a sleeper is handed the unit */
+
+#define SEM_NSEMS_MAX 256              /* max slots in a semaphore set (sys_allocate_semaphore_set) */
+
+/* Channels (sys_allocate_channel) */
+#define SEM_CHAN_ITEMS 0               /* slot counting messages to receive */
+#define SEM_CHAN_SPACE 1               /* slot counting free records to send into */
+#define SEM_CHAN_MAX 1024              /* max records in a channel */
+#define SEM_MSG_MAX 256                /* max bytes in a message */
+#define SEM_BATCH_MAX 64               /* max messages in one batched send or receive */
+
 /***** BEGIN ADDITION by Dawit ************************************/
 
 #ifndef SEMAPHORE_P
 #define SEMAPHORE_P
 
-/* Semahore struct; Dawit modified */
+/*
+ * Semahore struct; Dawit modified
+ *
+ * Laid out by access pattern.  A lookup walking an owner's list or a hash
+ * chain reads only the first cache line of every semaphore it passes; the
+ * name and credentials are read once the key matches; down and up work on
+ * the lock, klist and slots, which start on a line of their own.
+ */
+#define SEM_CACHELINE 64               /* line size the layout is arranged for */
+
 typedef struct semaphore {
-	struct proc *owner;                /* process that created the semaphore */
+    /* lookup: read for every semaphore passed */
+    LIST_ENTRY(semaphore) s_next;      /* node in owner's list, or group/global hash chain */
+    u_int64_t key;                     /* interned name: compared before name */
+	struct proc *owner;                /* process that created the semaphore, NULL if it outlives it */
+    struct pgrp *pgrp;                 /* group it is attached to (SEM_SCOPE_PGRP) */
+    short type;                        /* SEM_TYPE_* object behind the name */
+    short scope;                       /* SEM_SCOPE_* namespace it lives in */
+    int flags;                         /* SEM_BARGE, SEM_MUTEX */
+    int nsems;                         /* slots in the set, 1 for a plain semaphore */
+
+    /* cold: read on a key match and for permission checks */
     char name[MAX_NAME_LENGTH];        /* string name of semaphore */
-    int count;                         /* control variable of semaphore */
-    lock_data_t mutex;                 /* lock structure */
-    SIMPLEQ_HEAD(,p_node) p_head;  	   /* list of processes waiting on semaphore */
-    LIST_ENTRY(semaphore) s_next;      /* node in system wide list of semaphores */
+    uid_t uid;                         /* creator's credentials (SEM_SCOPE_GLOBAL) */
+    gid_t gid;
+    mode_t mode;                       /* access permissions (SEM_SCOPE_GLOBAL) */
+
+    /* hot: read and written by every down, up and barrier wait */
+    struct simplelock interlock        /* guards klist, barrier state and every slot */
+        __attribute__((__aligned__(SEM_CACHELINE)));
+    struct klist klist;                /* EVFILT_SEMAPHORE knotes watching the slots */
+    int parties;                       /* processes per phase (SEM_TYPE_BARRIER) */
+    u_int generation;                  /* phases completed (SEM_TYPE_BARRIER) */
+    struct proc *holder;               /* process that downed it (SEM_MUTEX), else NULL */
+    LIST_ENTRY(semaphore) s_held;      /* node in holder's p_semheld */
+    struct sem_ring *ring;             /* message records (SEM_TYPE_CHANNEL), else NULL */
+    int refs;                          /* channel calls using it across a sleep */
+    int dead;                          /* destroyed, freed once refs drops to 0 */
+    struct sem_slot {
+      int count;                       /* control variable of semaphore */
+      SIMPLEQ_HEAD(,p_node) p_head;    /* list of processes waiting on semaphore */
+    } slot[1];                         /* nsems slots, allocated along with the semaphore */
 } semaphore_t;
 
+/*
+ * Ring of message records behind a channel.  Its two slots count what the
+ * ring holds, so a process that has downed one is owed a record and only
+ * takes the interlock to copy it in or out.
+ */
+struct sem_ring {
+  int capacity;                        /* records in the ring */
+  int msgsize;                         /* bytes per record */
+  int head;                            /* next record to receive */
+  int tail;                            /* next record to fill */
+  int used;                            /* records holding a message */
+  /* capacity message lengths follow, then capacity records of msgsize bytes */
+};
+
+#define SEM_RING_SIZE(cap, size) (sizeof(struct sem_ring) + (cap) * (sizeof(int) + (size)))
+#define SEM_RING_LEN(r, i) (((int *)((r) + 1))[i])
+#define SEM_RING_MSG(r, i) ((char *)((int *)((r) + 1) + (r)->capacity) + (i) * (r)->msgsize)
+
+/* Bytes to malloc for a set of n slots */
+#define SEM_SIZE(n) (sizeof(semaphore_t) + ((n) - 1) * sizeof(struct sem_slot))
+
 /*
  * Node of SIMPLEQ (defined above) used to keep track of waiting processes in semaphore
  */
 struct p_node {
   struct proc *p;                      /* pointer to process */
+  int state;                           /* why the process was woken, see below */
+  struct semaphore *sem;               /* semaphore queued on, NULL once dequeued */
+  struct p_node *group;                /* first node of a wait-for-any, else NULL */
+  int nany;                            /* first node: nodes in the wait-for-any */
+  int which;                           /* first node: index that ended the wait */
+  int passed;                          /* SEM_BARGE: times another process took our unit */
   SIMPLEQ_ENTRY(p_node) p_next;        /* link to next entry */
 };
 
+#define SEM_ANY_MAX 16                 /* max names in one sys_down_semaphore_any */
+
+#define P_NODE_WAITING 0               /* still queued */
+#define P_NODE_POSTED  1               /* dequeued by up: semaphore acquired */
+#define P_NODE_GONE    2               /* dequeued by free/exit: semaphore destroyed */
+#define P_NODE_RETRY   3               /* SEM_BARGE: still queued, woken to compete for a unit */
+
+/*
+ * One buffer of a batched cipher (sys_cipher_vector).  The call copies the
+ * array back with cv_done and cv_error filled in for every entry.
+ */
+struct cipher_vec {
+  char *cv_base;                       /* buffer, ciphered in place */
+  size_t cv_len;                       /* bytes in the buffer */
+  int cv_lkey;                         /* keys for this buffer (CIPHER_OWNKEYS) */
+  int cv_nkey;
+  size_t cv_done;                      /* out: bytes ciphered */
+  int cv_error;                        /* out: errno for this buffer, 0 if done whole */
+};
+
+#define CIPHER_VEC_MAX 1024            /* max buffers in one sys_cipher_vector */
+#define CIPHER_OWNKEYS 0x01            /* use each buffer's keys instead of the shared pair */
+#define CIPHER_INVERSE 0x02            /* decipher, as sys_decipher_buffer */
+#define CIPHER_FLAGS (CIPHER_OWNKEYS | CIPHER_INVERSE)
+
+#ifdef _KERNEL
+void exit_semaphores(struct proc *);   /* release semaphores of an exiting process */
+void pgrp_semaphores(struct pgrp *);   /* release semaphores of a deleted group */
+extern struct filterops sem_filtops;   /* EVFILT_SEMAPHORE */
+#endif
+
 #endif
 
 /***** END ADDITION by Dawit ************************************/
@@ -0,0 +1,241 @@
+/*
+ * semaphore.hpp -- C++ wrapper for the COP4600 semaphore system calls
+ *
+ * Header only; needs a C++11 compiler and <sys/syscall.h> from a kernel
+ * built with syscalls 292-297.
+ *
+ *	sem::semaphore s("jobs", 0);		// allocate, freed on scope exit
+ *	{
+ *		sem::scoped_down guard(s);	// down now, up on scope exit
+ *		...
+ *	}
+ *	sem::handle h("Sem_P");			// inherited, group or global
+ *	h.up();
+ *
+ * A name is validated and copied once, into storage inside the object,
+ * when the object is built; every operation after that is a single trap
+ * with a pointer to that copy.  Nothing allocates on the heap.  The kernel
+ * still resolves the name on every call -- there is no handle based entry
+ * point to cache the lookup in -- so the per-call cost is the trap plus
+ * the kernel's own find_semaphore().
+ *
+ * Operations report failure as the errno value the kernel returned (0 on
+ * success) and never throw.  Constructors that allocate throw
+ * std::system_error, since there is no object to hand back otherwise.
+ */
+
+#ifndef _SEMAPHORE_HPP_
+#define _SEMAPHORE_HPP_
+
+#include <sys/syscall.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <cstring>
+#include <system_error>
+
+namespace sem {
+
+/* Keep in step with proc.h */
+const std::size_t MAX_NAME_LENGTH = 32;	/* including the terminator */
+
+enum class scope : int {
+	process = 0,	/* SEM_SCOPE_PROC: creator and its descendants */
+	group = 1,	/* SEM_SCOPE_PGRP: the creator's process group */
+};
+
+namespace detail {
+
+inline int
+result(long rv)
+{
+	return (rv == -1 ? errno : 0);
+}
+
+} /* namespace detail */
+
+/*
+ * Non-owning reference to a semaphore by name.  The semaphore itself may
+ * belong to this process, an ancestor, the process group or the global
+ * namespace; handle does not care and never frees it.
+ */
+class handle {
+public:
+	handle() noexcept : error_(ENOENT) { name_[0] = '\0'; }
+
+	explicit handle(const char *name) noexcept : error_(0)
+	{
+		std::size_t len = std::strlen(name);
+
+		if (len >= MAX_NAME_LENGTH) {
+			name_[0] = '\0';
+			error_ = ENAMETOOLONG;
+		} else
+			std::memcpy(name_, name, len + 1);
+	}
+
+	handle(const handle &) noexcept = default;
+	handle &operator=(const handle &) noexcept = default;
+
+	/* ENAMETOOLONG if the name did not fit, else 0 */
+	int error() const noexcept { return error_; }
+	const char *name() const noexcept { return name_; }
+
+	int
+	down() const noexcept
+	{
+		if (error_ != 0)
+			return error_;
+		return detail::result(::syscall(SYS_down_semaphore, name_));
+	}
+
+	int
+	up() const noexcept
+	{
+		if (error_ != 0)
+			return error_;
+		return detail::result(::syscall(SYS_up_semaphore, name_));
+	}
+
+protected:
+	char name_[MAX_NAME_LENGTH];
+	int error_;
+};
+
+/*
+ * Semaphore allocated by this object and freed when it is destroyed.
+ * Move-only: exactly one object is responsible for the free.
+ */
+class semaphore : public handle {
+public:
+	semaphore(const char *name, int count, sem::scope s = scope::process)
+	    : handle(name), owned_(false)
+	{
+		if (error_ == 0)
+			error_ = detail::result(s == scope::process ?
+			    ::syscall(SYS_allocate_semaphore, name_, count) :
+			    ::syscall(SYS_allocate_semaphore_scope, name_, count,
+			    static_cast<int>(s)));
+		check("allocate_semaphore");
+		owned_ = true;
+	}
+
+	/*
+	 * Global named semaphore ("/name"), created if absent.  Only the call
+	 * that creates it takes ownership: opening one that already exists
+	 * gives a non-owning object, so its destruction leaves the semaphore
+	 * to whoever created it.
+	 */
+	static semaphore
+	open(const char *name, int count, int mode = 0600, int oflag = O_CREAT)
+	{
+		semaphore s(name);
+
+		while (s.error_ == 0) {
+			if (oflag & O_CREAT) {
+				s.error_ = detail::result(::syscall(
+				    SYS_open_semaphore, s.name_, oflag | O_EXCL,
+				    mode, count));
+				if (s.error_ == 0) {
+					s.owned_ = true;
+					break;
+				}
+				if (s.error_ != EEXIST || (oflag & O_EXCL))
+					break;
+			}
+			s.error_ = detail::result(::syscall(SYS_open_semaphore,
+			    s.name_, oflag & ~(O_CREAT | O_EXCL), mode, count));
+			if (s.error_ != ENOENT || (oflag & O_CREAT) == 0)
+				break;
+			s.error_ = 0;	/* freed since the EEXIST: create it */
+		}
+		s.check("open_semaphore");
+		return s;
+	}
+
+	semaphore(semaphore &&other) noexcept
+	    : handle(other), owned_(other.owned_)
+	{
+		other.owned_ = false;
+	}
+
+	semaphore &
+	operator=(semaphore &&other) noexcept
+	{
+		if (this != &other) {
+			release();
+			handle::operator=(other);
+			owned_ = other.owned_;
+			other.owned_ = false;
+		}
+		return *this;
+	}
+
+	semaphore(const semaphore &) = delete;
+	semaphore &operator=(const semaphore &) = delete;
+
+	~semaphore() { release(); }
+
+	/* Whether destruction or release() frees the semaphore */
+	bool owned() const noexcept { return owned_; }
+
+	/* Free now rather than at destruction; returns the kernel's errno */
+	int
+	release() noexcept
+	{
+		if (!owned_)
+			return 0;
+		owned_ = false;
+		return detail::result(::syscall(SYS_free_semaphore, name_));
+	}
+
+	/* Give up ownership without freeing, e.g. to leave it to a child */
+	handle
+	detach() noexcept
+	{
+		owned_ = false;
+		return *this;
+	}
+
+private:
+	explicit semaphore(const char *name) : handle(name), owned_(false) {}
+
+	void
+	check(const char *what)
+	{
+		if (error_ != 0)
+			throw std::system_error(error_, std::generic_category(),
+			    what);
+	}
+
+	bool owned_;
+};
+
+/* down() on construction, up() on destruction */
+class scoped_down {
+public:
+	explicit scoped_down(const handle &h) noexcept
+	    : h_(&h), error_(h.down()) {}
+
+	scoped_down(const scoped_down &) = delete;
+	scoped_down &operator=(const scoped_down &) = delete;
+
+	~scoped_down()
+	{
+		if (error_ == 0)
+			h_->up();
+	}
+
+	/* Whether the down succeeded; nothing is released if it did not */
+	int error() const noexcept { return error_; }
+	explicit operator bool() const noexcept { return error_ == 0; }
+
+private:
+	const handle *h_;
+	int error_;
+};
+
+} /* namespace sem */
+
+#endif /* !_SEMAPHORE_HPP_ */
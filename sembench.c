@@ -0,0 +1,283 @@
+/*
+ * sembench.c -- performance of the semaphore system calls
+ *
+ * usage: sembench [-n iterations] [-p producers] [-c consumers]
+ *
+ * Runs five benchmarks on a patched kernel:
+ *   pingpong   two-process round trip: up(ping)/down(pong) against
+ *              down(ping)/up(pong) in a child
+ *   prodcons   p producers up() and c consumers down() one semaphore
+ *   lookup     up() on a semaphore owned by an ancestor `depth' levels
+ *              up, with `owned' other semaphores on every level
+ *   churn      allocate/free of one name
+ *   spread     up()/down() on one of `nsems' semaphores picked at random,
+ *              which walks the owner's list through cold cache lines
+ *
+ * Each result is printed as a single line of key=value pairs, e.g.
+ *   bench=pingpong iters=100000 ns_per_op=5321.4
+ * so runs against different kernel builds can be diffed or graphed.
+ */
+
+#include <sys/types.h>
+#include <sys/syscall.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#define allocate(name, count)	syscall(SYS_allocate_semaphore, (name), (count))
+#define down(name)		syscall(SYS_down_semaphore, (name))
+#define up(name)		syscall(SYS_up_semaphore, (name))
+#define release(name)		syscall(SYS_free_semaphore, (name))
+
+static int iters = 100000;
+
+static double
+now(void)
+{
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+	return (tv.tv_sec + tv.tv_usec / 1e6);
+}
+
+static void
+fail(const char *what)
+{
+	fprintf(stderr, "sembench: %s: errno %d\n", what, errno);
+	exit(1);
+}
+
+static void
+reap(int n)
+{
+	int status;
+
+	while (n-- > 0)
+		if (wait(&status) == -1 || status != 0)
+			fail("child");
+}
+
+static void
+report(const char *bench, const char *params, int ops, double secs)
+{
+	printf("bench=%s %siters=%d ns_per_op=%.1f ops_per_sec=%.0f\n", bench,
+	    params, ops, secs * 1e9 / ops, ops / secs);
+	fflush(stdout);
+}
+
+/* (a) two-process ping-pong round trip */
+static void
+pingpong(void)
+{
+	double t;
+	int i;
+
+	if (allocate("bench_ping", 0) == -1 || allocate("bench_pong", 0) == -1)
+		fail("allocate");
+	if (fork() == 0) {
+		for (i = 0; i < iters; i++)
+			if (down("bench_ping") == -1 || up("bench_pong") == -1)
+				_exit(1);
+		_exit(0);
+	}
+	t = now();
+	for (i = 0; i < iters; i++)
+		if (up("bench_ping") == -1 || down("bench_pong") == -1)
+			fail("pingpong");
+	t = now() - t;
+	reap(1);
+	report("pingpong", "", iters, t);
+	release("bench_ping");
+	release("bench_pong");
+}
+
+/* (b) nprod producers and ncons consumers on one semaphore */
+static void
+prodcons(int nprod, int ncons)
+{
+	char params[64];
+	double t;
+	int i, j, total;
+
+	total = iters - iters % (nprod * ncons);	/* split evenly */
+	if (allocate("bench_items", 0) == -1 || allocate("bench_go", 0) == -1)
+		fail("allocate");
+	for (i = 0; i < nprod + ncons; i++) {
+		if (fork() != 0)
+			continue;
+		if (down("bench_go") == -1)
+			_exit(1);
+		if (i < nprod) {
+			for (j = 0; j < total / nprod; j++)
+				if (up("bench_items") == -1)
+					_exit(1);
+		} else {
+			for (j = 0; j < total / ncons; j++)
+				if (down("bench_items") == -1)
+					_exit(1);
+		}
+		_exit(0);
+	}
+	usleep(100000);				/* let everyone block */
+	t = now();
+	for (i = 0; i < nprod + ncons; i++)
+		up("bench_go");
+	reap(nprod + ncons);
+	t = now() - t;
+	snprintf(params, sizeof(params), "producers=%d consumers=%d ", nprod,
+	    ncons);
+	report("prodcons", params, total, t);
+	release("bench_items");
+	release("bench_go");
+}
+
+/* Allocate `owned' filler semaphores in the calling process */
+static void
+fill(int owned)
+{
+	char name[32];
+	int i;
+
+	for (i = 0; i < owned; i++) {
+		snprintf(name, sizeof(name), "bench_pad%d", i);
+		if (allocate(name, 0) == -1)
+			fail("allocate pad");
+	}
+}
+
+/*
+ * (c) lookup of a semaphore `depth' ancestors up, `owned' fillers each.
+ * A process that owns nothing does not pass its inheritance on to children
+ * forked from it, so every level needs at least one filler for the chain
+ * to reach bench_root.
+ */
+static void
+lookup(int depth, int owned)
+{
+	char params[64];
+	double t;
+	int i;
+
+	if (allocate("bench_root", 0) == -1)
+		fail("allocate");
+	fill(owned);
+	if (fork() == 0) {
+		fill(owned);
+		for (i = 1; i < depth; i++) {
+			if (fork() != 0) {
+				reap(1);
+				_exit(0);
+			}
+			fill(owned);
+		}
+		t = now();
+		for (i = 0; i < iters; i++)
+			if (up("bench_root") == -1)
+				_exit(1);
+		t = now() - t;
+		snprintf(params, sizeof(params), "depth=%d owned=%d ", depth,
+		    owned);
+		report("lookup", params, iters, t);
+		_exit(0);
+	}
+	reap(1);
+	release("bench_root");
+	while (owned-- > 0) {
+		char name[32];
+
+		snprintf(name, sizeof(name), "bench_pad%d", owned);
+		release(name);
+	}
+}
+
+/* (d) allocate/free churn */
+static void
+churn(void)
+{
+	double t;
+	int i;
+
+	t = now();
+	for (i = 0; i < iters; i++)
+		if (allocate("bench_churn", 0) == -1 ||
+		    release("bench_churn") == -1)
+			fail("churn");
+	t = now() - t;
+	report("churn", "", iters, t);
+}
+
+/* (e) up/down spread at random over nsems semaphores */
+static void
+spread(int nsems)
+{
+	char name[32], params[64];
+	unsigned int seed = 1;
+	double t;
+	int i, j, n;
+
+	for (i = 0; i < nsems; i++) {
+		snprintf(name, sizeof(name), "bench_spread%d", i);
+		if (allocate(name, 0) == -1)
+			fail("allocate spread");
+	}
+	n = iters / (nsems / 64 + 1);
+	t = now();
+	for (i = 0; i < n; i++) {
+		j = rand_r(&seed) % nsems;
+		snprintf(name, sizeof(name), "bench_spread%d", j);
+		if (up(name) == -1 || down(name) == -1)
+			fail("spread");
+	}
+	t = now() - t;
+	snprintf(params, sizeof(params), "nsems=%d ", nsems);
+	report("spread", params, n, t);
+	for (i = 0; i < nsems; i++) {
+		snprintf(name, sizeof(name), "bench_spread%d", i);
+		release(name);
+	}
+}
+
+int
+main(int argc, char *argv[])
+{
+	static const int depths[] = { 1, 4, 16, 64 };
+	static const int owned[] = { 1, 8, 64 };	/* >= 1: see lookup() */
+	int nprod = 4, ncons = 4;
+	int ch, i, j;
+
+	while ((ch = getopt(argc, argv, "n:p:c:")) != -1) {
+		switch (ch) {
+		case 'n':
+			iters = atoi(optarg);
+			break;
+		case 'p':
+			nprod = atoi(optarg);
+			break;
+		case 'c':
+			ncons = atoi(optarg);
+			break;
+		default:
+			fprintf(stderr, "usage: sembench [-n iterations] "
+			    "[-p producers] [-c consumers]\n");
+			return (1);
+		}
+	}
+	if (iters <= 0 || nprod <= 0 || ncons <= 0 || iters < nprod * ncons) {
+		fprintf(stderr, "sembench: bad arguments\n");
+		return (1);
+	}
+
+	pingpong();
+	prodcons(1, 1);
+	prodcons(nprod, ncons);
+	for (i = 0; i < sizeof(depths) / sizeof(depths[0]); i++)
+		for (j = 0; j < sizeof(owned) / sizeof(owned[0]); j++)
+			lookup(depths[i], owned[j]);
+	churn();
+	spread(64);
+	spread(1024);
+	return (0);
+}
@@ -0,0 +1,251 @@
+/*
+ * semtest.cc -- kerntest.c parts 1 to 4 on top of semaphore.hpp
+ *
+ * c++ -std=c++11 -o semtest semtest.cc
+ *
+ * Every check states the errno it expects and prints PASS or FAIL, so the
+ * run can be judged without reading the log against REPORT.md.
+ */
+
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "semaphore.hpp"
+
+static int failures;
+
+static const char *
+errname(int err)
+{
+	switch (err) {
+	case 0:			return "SUCCESS";
+	case EFAULT:		return "EFAULT";
+	case ENOMEM:		return "ENOMEM";
+	case ENAMETOOLONG:	return "ENAMETOOLONG";
+	case EEXIST:		return "EEXIST";
+	case EDOM:		return "EDOM";
+	case ENOENT:		return "ENOENT";
+	default:		return strerror(err);
+	}
+}
+
+static void
+expect(const char *what, int got, int want)
+{
+	printf("%-44s %-14s %s\n", what, errname(got),
+	    got == want ? "PASS" : "FAIL");
+	if (got != want)
+		failures++;
+}
+
+/* Allocate through the RAII type, reporting the errno instead of throwing */
+static int
+allocate(const char *name, int count)
+{
+	try {
+		sem::semaphore s(name, count);
+		s.detach();		/* leave it for later checks */
+	} catch (const std::system_error &e) {
+		return e.code().value();
+	}
+	return 0;
+}
+
+static void
+part1(void)
+{
+	printf("\n_________________ PART 1: BASIC CALLS _________________\n");
+
+	expect("allocate (Sem1, 0)", allocate("Sem1", 0), 0);
+	expect("allocate (Sem1, 0) again", allocate("Sem1", 0), EEXIST);
+	expect("allocate (37 char name, 0)",
+	    allocate("abcdefghijklmnopqrstuvwxyz01234567890", 0), ENAMETOOLONG);
+	expect("allocate (Sem_negative, -1)", allocate("Sem_negative", -1),
+	    EDOM);
+
+	expect("up (Sem1)", sem::handle("Sem1").up(), 0);
+	expect("up (Sem_noexist)", sem::handle("Sem_noexist").up(), ENOENT);
+
+	{
+		sem::semaphore guard_me("Sem_guard", 1);
+		sem::scoped_down g(guard_me);
+
+		expect("scoped down (Sem_guard)", g.error(), 0);
+	}
+	expect("freed on scope exit (Sem_guard)",
+	    sem::handle("Sem_guard").up(), ENOENT);
+
+	sem::semaphore moved("Sem_move", 0);
+	sem::semaphore target(std::move(moved));
+	expect("release moved-from (Sem_move)", moved.release(), 0);
+	expect("release moved-to (Sem_move)", target.release(), 0);
+	expect("up after release (Sem_move)", sem::handle("Sem_move").up(),
+	    ENOENT);
+
+	/* Only the creator of a global semaphore frees it */
+	{
+		sem::semaphore creator = sem::semaphore::open("/Sem_global", 0);
+		{
+			sem::semaphore second =
+			    sem::semaphore::open("/Sem_global", 0);
+			{
+				sem::semaphore first =
+				    sem::semaphore::open("/Sem_global", 0);
+			}
+			expect("up (/Sem_global) after first open destroyed",
+			    second.up(), 0);
+		}
+		expect("up (/Sem_global) after both opens destroyed",
+		    creator.up(), 0);
+		expect("release creator (/Sem_global)", creator.release(), 0);
+	}
+	expect("up (/Sem_global) after release",
+	    sem::handle("/Sem_global").up(), ENOENT);
+
+	/* Sem1 was detached above; take it back to free it */
+	expect("free (Sem1)", syscall(SYS_free_semaphore, "Sem1") == -1 ?
+	    errno : 0, 0);
+	expect("up (Sem1) after free", sem::handle("Sem1").up(), ENOENT);
+}
+
+static void
+part2(void)
+{
+	pid_t pid1, pid2;
+
+	printf("\n_________________ PART 2: INHERITANCE __________________\n");
+
+	sem::semaphore sem_p("Sem_P", 0);
+
+	if ((pid1 = fork()) == 0) {
+		sem::semaphore mine("Sem_P", 0);	/* shadows parent's */
+		sem::semaphore c1("Sem_C1", 0);
+
+		expect("child 1: down (Sem_C2)", sem::handle("Sem_C2").down(),
+		    ENOENT);
+		usleep(2000000);
+		expect("child 1: up own (Sem_P)", mine.up(), 0);
+		expect("child 1: free own (Sem_P)", mine.release(), 0);
+		expect("child 1: up inherited (Sem_P)", sem_p.up(), 0);
+		_exit(failures != 0);
+	}
+	if ((pid2 = fork()) == 0) {
+		sem::semaphore c2("Sem_C2", 0);
+
+		expect("child 2: down inherited (Sem_P)", sem_p.down(), 0);
+		expect("child 2: down (Sem_C1)", sem::handle("Sem_C1").down(),
+		    ENOENT);
+		_exit(failures != 0);
+	}
+
+	for (int i = 0, status; i < 2; i++)
+		if (wait(&status) == -1 || status != 0)
+			failures++;
+}
+
+static void
+part3(void)
+{
+	char order[4], c;
+	int fds[2], i, n, status;
+
+	printf("\n_________________ PART 3: FAIRNESS _____________________\n");
+
+	sem::semaphore fair("Fair", 0);
+
+	if (pipe(fds) == -1) {
+		failures++;
+		return;
+	}
+	for (i = 0; i < 3; i++) {
+		if (fork() == 0) {
+			c = '1' + i;
+			if (fair.down() != 0)
+				_exit(1);
+			write(fds[1], &c, 1);	/* record the order woken */
+			_exit(0);
+		}
+		usleep(500000);			/* queue in fork order */
+	}
+	close(fds[1]);
+	for (i = 0; i < 3; i++) {
+		expect("up (Fair)", fair.up(), 0);
+		usleep(500000);			/* let the woken child report */
+	}
+	for (i = 0; i < 3; i++)
+		if (wait(&status) == -1 || status != 0)
+			failures++;
+
+	for (n = 0; n < 3 && read(fds[0], &order[n], 1) == 1; n++)
+		;
+	order[n] = '\0';
+	close(fds[0]);
+	printf("%-44s %-14s %s\n", "downs woken in arrival order (123)", order,
+	    strcmp(order, "123") == 0 ? "PASS" : "FAIL");
+	if (strcmp(order, "123") != 0)
+		failures++;
+}
+
+static void
+part4(void)
+{
+	pid_t owner;
+	int fds[2], fail, status, before = failures;
+
+	printf("\n_________________ PART 4: FREE ON EXIT ________________\n");
+
+	if (pipe(fds) == -1) {
+		failures++;
+		return;
+	}
+	if ((owner = fork()) == 0) {
+		/* Not freed by this process: its exit has to do it */
+		sem::semaphore a("Sem A", 0), b("Sem B", 0);
+		sem::semaphore ready("Sem Ready", 0);
+
+		a.detach();
+		b.detach();
+		ready.detach();
+		if (fork() == 0) {
+			expect("grandchild: up inherited (Sem A)", a.up(), 0);
+			expect("grandchild: up inherited (Sem B)", b.up(), 0);
+			expect("grandchild: up (Sem Control)",
+			    sem::handle("Sem Control").up(), ENOENT);
+			ready.up();
+			while (getppid() != 1)
+				usleep(10000);	/* until the owner has exited */
+			expect("grandchild: up (Sem A) after owner exit",
+			    a.up(), ENOENT);
+			expect("grandchild: up (Sem B) after owner exit",
+			    b.up(), ENOENT);
+			fail = failures - before;
+			write(fds[1], &fail, sizeof(fail));
+			_exit(0);
+		}
+		ready.down();
+		_exit(0);
+	}
+	close(fds[1]);
+	if (waitpid(owner, &status, 0) == -1 || status != 0)
+		failures++;
+	if (read(fds[0], &fail, sizeof(fail)) != sizeof(fail) || fail != 0)
+		failures++;
+	close(fds[0]);
+}
+
+int
+main()
+{
+	printf("\n=============== START SEMAPHORE TEST (C++) =========\n");
+	part1();
+	part2();
+	part3();
+	part4();
+	printf("\n=============== %s ======================\n",
+	    failures ? "FAILED" : "PASSED");
+	return (failures != 0);
+}
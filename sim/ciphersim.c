@@ -0,0 +1,851 @@
+/*
+ * Functional checks and throughput benchmarks for the cipher system call,
+ * run against the real cop4600.c inside the simulation harness.
+ *
+ * usage: ciphersim [-q] [-n rounds] [-s seed]
+ *
+ *   -q  skip the benchmarks
+ *   -n  rounds of the fuzz check (default 20000)
+ *   -s  seed of the fuzz check (default the time)
+ *
+ * Every optimized pass is fuzzed against ref_cipher(), written from the
+ * description of the cipher rather than from the kernel code, over random
+ * keys of either sign and random lengths and alignments.
+ *
+ * Failed checks print a FAIL line and the run ends with "ok" or "FAIL";
+ * benchmarks print one "bench=<name> <key>=<value> ..." line each, with
+ * the throughput in bytes per second.  bench=sweep times the reference,
+ * the original two passes, the fused pass and sys_cipher_buffer() over
+ * sizes from 1 byte to 1 MiB.
+ */
+
+#include <errno.h>
+#include <limits.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "sim.h"
+#include <sys/proc.h>		/* struct cipher_vec */
+
+static int failures;
+
+#define CHECK(expr, want) do {						\
+	int got_ = (expr);						\
+	if (got_ != (want)) {						\
+		printf("FAIL %s:%d: %s = %d, want %d\n", __FILE__,	\
+		    __LINE__, #expr, got_, (want));			\
+		failures++;						\
+	}								\
+} while (0)
+
+/* Keys worth covering: signs, parities, multiples of 26 and 10, extremes */
+static const int keys[] = {
+	0, 1, 2, 3, 10, 25, 26, 27, 52, 1000001, INT_MAX,
+	-1, -2, -3, -25, -26, -27, -52, -1000001, INT_MIN,
+};
+#define NKEYS	(sizeof(keys) / sizeof(keys[0]))
+
+static double
+now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (ts.tv_sec + ts.tv_nsec / 1e9);
+}
+
+static void
+fill_random(char *buf, int len, unsigned int *seed)
+{
+	int i;
+
+	for (i = 0; i < len; i++)
+		buf[i] = rand_r(seed);
+}
+
+/*
+ * transposition() as it was before it went a word at a time: swap the
+ * 1st/3rd and 2nd/4th chars of every quad, then the 1st/3rd of a three
+ * char tail or the two chars of a two char tail.
+ */
+static void
+transpose_bytes(char *text, int len)
+{
+	int i, tail = len % 4;
+	char t;
+
+	for (i = 0; i < len - tail; i += 4) {
+		t = text[i]; text[i] = text[i + 2]; text[i + 2] = t;
+		t = text[i + 1]; text[i + 1] = text[i + 3]; text[i + 3] = t;
+	}
+	if (tail == 3) {
+		t = text[i]; text[i] = text[i + 2]; text[i + 2] = t;
+	} else if (tail == 2) {
+		t = text[i]; text[i] = text[i + 1]; text[i + 1] = t;
+	}
+}
+
+/*
+ * The two passes the kernel ran before cipher_apply() fused them, kept
+ * here as the two-pass baseline.  substitution_apply() runs text through
+ * a table from substitution_table(); transposition() swaps the halves of
+ * every quad a word at a time, a 16-bit rotate of each 32-bit lane
+ * whatever the byte order, and the short tail by hand.
+ *
+ * The word-at-a-time transposition is a measurement baseline only: it
+ * went into the kernel briefly and left again when cipher_apply() fused
+ * both passes into one table lookup and byte store per character, which
+ * beat it.  No kernel code transposes a word at a time.
+ */
+static void
+substitution_apply(char *text, int len, unsigned char *table)
+{
+	int i;
+
+	for (i = 0; i < len; i++)
+		text[i] = table[(unsigned char)text[i]];
+}
+
+#ifdef __LP64__
+#define QUAD_LANES	0x0000ffff0000ffffUL
+#else
+#define QUAD_LANES	0x0000ffffUL
+#endif
+#define QUAD_SWAP(w) ((((w) >> 16) & QUAD_LANES) | (((w) & QUAD_LANES) << 16))
+
+static void
+transposition(char *text, int len, int lkey, int nkey)
+{
+	int i, tail = len % 4;
+	unsigned long w;
+	uint32_t q;
+	char t;
+
+	for (i = 0; i + (int)sizeof(w) <= len - tail; i += sizeof(w)) {
+		memcpy(&w, text + i, sizeof(w));
+		w = QUAD_SWAP(w);
+		memcpy(text + i, &w, sizeof(w));
+	}
+	if (i < len - tail) {		/* a quad left over */
+		memcpy(&q, text + i, sizeof(q));
+		q = (q >> 16) | (q << 16);
+		memcpy(text + i, &q, sizeof(q));
+		i += 4;
+	}
+	if (tail == 3) {
+		t = text[i]; text[i] = text[i + 2]; text[i + 2] = t;
+	} else if (tail == 2) {
+		t = text[i]; text[i] = text[i + 1]; text[i + 1] = t;
+	}
+}
+
+/*
+ * The cipher, spelled out.
+ *
+ * Substitution moves every letter lkey places along the alphabet and
+ * every digit nkey places along 0-9, wrapping around (a negative key
+ * moves backwards).  A letter then keeps its case if its new position,
+ * counting 'a' as 0, is odd, and changes case if it is even; a negative
+ * odd lkey turns that rule around.  Any other byte is left alone.
+ *
+ * Transposition splits the text into quads abcd and rewrites each as
+ * cdab.  A short quad at the end is abc -> cba, ab -> ba, a -> a.
+ */
+static int
+ref_shift(int pos, int key, int n)
+{
+	return (((pos + key % n) % n + n) % n);
+}
+
+static void
+ref_cipher(char *text, int len, int lkey, int nkey)
+{
+	int flip = (lkey < 0 && lkey % 2 != 0);
+	int i, pos, upper, odd;
+	char q[4];
+
+	for (i = 0; i < len; i++) {
+		unsigned char c = text[i];
+
+		if ((c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z')) {
+			upper = (c <= 'Z');
+			pos = ref_shift(c - (upper ? 'A' : 'a'), lkey, 26);
+			odd = (pos % 2 == 1);
+			if (odd == flip)
+				upper = !upper;
+			text[i] = (upper ? 'A' : 'a') + pos;
+		} else if (c >= '0' && c <= '9')
+			text[i] = '0' + ref_shift(c - '0', nkey, 10);
+	}
+
+	for (i = 0; i + 4 <= len; i += 4) {
+		memcpy(q, text + i, 4);
+		text[i] = q[2];
+		text[i + 1] = q[3];
+		text[i + 2] = q[0];
+		text[i + 3] = q[1];
+	}
+	if (len - i == 3) {
+		q[0] = text[i];
+		text[i] = text[i + 2];
+		text[i + 2] = q[0];
+	} else if (len - i == 2) {
+		q[0] = text[i];
+		text[i] = text[i + 1];
+		text[i + 1] = q[0];
+	}
+}
+
+/* A random key: one from keys[] or anything in the int range */
+static int
+fuzz_key(unsigned int *seed)
+{
+	if (rand_r(seed) % 4 == 0)
+		return (keys[rand_r(seed) % NKEYS]);
+	return ((int)((unsigned int)rand_r(seed) << 16 ^ rand_r(seed)));
+}
+
+/* --------- FUNCTIONAL CHECKS --------- */
+
+/* The reference against hand-worked examples */
+static void
+check_reference(void)
+{
+	char buf[32];
+
+	/* a->b (pos 1, odd: keeps case), b->c (pos 2, even: flips), 9->0 */
+	strcpy(buf, "ab9");
+	ref_cipher(buf, 3, 1, 1);
+	CHECK(strcmp(buf, "0Cb"), 0);
+	/* negative odd lkey: a->z (pos 25, odd: flips), Z->Y (even: keeps) */
+	strcpy(buf, "aZ");
+	ref_cipher(buf, 2, -1, 0);
+	CHECK(strcmp(buf, "YZ"), 0);
+	/* quad plus short quad of 3 */
+	strcpy(buf, "1234567");
+	ref_cipher(buf, 7, 0, 0);
+	CHECK(strcmp(buf, "3412765"), 0);
+}
+
+/*
+ * Every implementation against the reference: the original per-character
+ * passes, the fused pass, the length-delimited system call, and that
+ * deciphering takes the result back.
+ */
+static void
+check_fuzz(int rounds, unsigned int seed)
+{
+	struct proc *p = sim_fork(NULL);
+	char orig[4096 + 16], want[4096 + 16], got[4096 + 16];
+	int i, len, off, lkey, nkey, bad;
+	unsigned int s = seed;
+
+	for (i = 0; i < rounds; i++) {
+		len = rand_r(&s) % 8 ? rand_r(&s) % 64 : rand_r(&s) % 4096;
+		off = rand_r(&s) % 16;
+		lkey = fuzz_key(&s);
+		nkey = fuzz_key(&s);
+		fill_random(orig, sizeof(orig), &s);
+		memcpy(want, orig, sizeof(want));
+		ref_cipher(want + off, len, lkey, nkey);
+
+		bad = failures;
+		memcpy(got, orig, sizeof(got));
+		substitution(got + off, len, lkey, nkey);
+		transposition(got + off, len, lkey, nkey);
+		CHECK(memcmp(got, want, sizeof(want)), 0);
+
+		memcpy(got, orig, sizeof(got));
+		cipher_apply(got + off, len, substitution_table(lkey, nkey));
+		CHECK(memcmp(got, want, sizeof(want)), 0);
+
+		memcpy(got, orig, sizeof(got));
+		CHECK(sim_cipher_buffer(p, got + off, len, lkey, nkey, NULL),
+		    0);
+		CHECK(memcmp(got, want, sizeof(want)), 0);
+		CHECK(sim_decipher_buffer(p, got + off, len, lkey, nkey, NULL),
+		    0);
+		CHECK(memcmp(got, orig, sizeof(orig)), 0);
+
+		if (failures != bad) {
+			printf("FAIL fuzz seed=%u round=%d len=%d lkey=%d "
+			    "nkey=%d\n", seed, i, len, lkey, nkey);
+			break;
+		}
+	}
+	sim_exit(p);
+}
+
+/*
+ * The table pass must agree with the per-character code on every byte
+ * value, for enough distinct keys to cycle the table cache several times.
+ */
+static void
+check_table(void)
+{
+	char ref[4096], got[4096];
+	unsigned int seed = 1;
+	int i, j, round;
+
+	fill_random(ref, sizeof(ref), &seed);
+	for (i = 0; i < 256; i++)
+		ref[i] = i;
+	for (round = 0; round < 2; round++)
+		for (i = 0; i < NKEYS; i++)
+			for (j = 0; j < NKEYS; j++) {
+				memcpy(got, ref, sizeof(got));
+				substitution_apply(got, sizeof(got),
+				    substitution_table(keys[i], keys[j]));
+				substitution(ref, sizeof(ref), keys[i],
+				    keys[j]);
+				CHECK(memcmp(got, ref, sizeof(ref)), 0);
+			}
+
+	/* a hit must hand back the table it built, not rebuild it */
+	CHECK(substitution_table(5, 7) == substitution_table(5, 7), 1);
+	CHECK(substitution_table(5, 7) == substitution_table(31, 17), 1);
+}
+
+/*
+ * The word-at-a-time transposition against the byte swaps, on random
+ * lengths at random alignments so every tail and leftover quad is hit.
+ */
+static void
+check_transpose(void)
+{
+	char ref[1024 + 16], got[1024 + 16];
+	unsigned int seed = 2;
+	int i, len, off;
+
+	for (i = 0; i < 20000; i++) {
+		len = (i < 64) ? i : rand_r(&seed) % 1024;
+		off = rand_r(&seed) % 16;
+		fill_random(ref, sizeof(ref), &seed);
+		memcpy(got, ref, sizeof(got));
+		transpose_bytes(ref + off, len);
+		transposition(got + off, len, 0, 0);
+		CHECK(memcmp(got, ref, sizeof(ref)), 0);
+	}
+}
+
+/* The fused pass against substitution() then transposition() */
+static void
+check_fused(void)
+{
+	char ref[1024 + 16], got[1024 + 16];
+	unsigned int seed = 3;
+	int i, len, off, lkey, nkey;
+
+	for (i = 0; i < 20000; i++) {
+		len = (i < 64) ? i : rand_r(&seed) % 1024;
+		off = rand_r(&seed) % 16;
+		lkey = keys[rand_r(&seed) % NKEYS];
+		nkey = keys[rand_r(&seed) % NKEYS];
+		fill_random(ref, sizeof(ref), &seed);
+		memcpy(got, ref, sizeof(got));
+		substitution(ref + off, len, lkey, nkey);
+		transposition(ref + off, len, lkey, nkey);
+		cipher_apply(got + off, len, substitution_table(lkey, nkey));
+		CHECK(memcmp(got, ref, sizeof(ref)), 0);
+	}
+}
+
+/* sys_cipher() against the two passes run by hand */
+static void
+check_syscall(void)
+{
+	static const char *texts[] = {
+		"", "a", "ab", "abc", "abcd", "Hello, World 2004!",
+		"The quick brown fox jumps over the lazy dog 0123456789",
+	};
+	struct proc *p = sim_fork(NULL);
+	char buf[128], want[128];
+	int i, j, len, n;
+
+	for (i = 0; i < sizeof(texts) / sizeof(texts[0]); i++)
+		for (j = 0; j < NKEYS; j++) {
+			n = strlen(texts[i]) + 1;
+			memcpy(want, texts[i], n);
+			substitution(want, n, keys[j], keys[NKEYS - 1 - j]);
+			transposition(want, n, keys[j], keys[NKEYS - 1 - j]);
+			strcpy(buf, texts[i]);
+			CHECK(sim_cipher(p, buf, keys[j], keys[NKEYS - 1 - j],
+			    &len), 0);
+			CHECK(len, (int)strlen(want) + 1);
+			CHECK(strcmp(buf, want), 0);
+		}
+	sim_exit(p);
+}
+
+/*
+ * sys_cipher_buffer() on binary buffers around and well past the chunk
+ * size must match one cipher_apply() over the whole buffer.
+ */
+static void
+check_buffer(void)
+{
+	static const int lens[] = {
+		0, 1, 2, 3, 4, 5, 1023, 1024, 1025, 1026, 1027, 1028, 2048,
+		4099, 65536 + 2, 1 << 20,
+	};
+	struct proc *p = sim_fork(NULL);
+	unsigned int seed = 4;
+	char *ref, *got;
+	size_t done;
+	int i, len, lkey, nkey;
+
+	ref = malloc(1 << 20);
+	got = malloc(1 << 20);
+	for (i = 0; i < sizeof(lens) / sizeof(lens[0]); i++) {
+		len = lens[i];
+		lkey = keys[rand_r(&seed) % NKEYS];
+		nkey = keys[rand_r(&seed) % NKEYS];
+		fill_random(ref, len, &seed);
+		memcpy(got, ref, len);
+		cipher_apply(ref, len, substitution_table(lkey, nkey));
+		CHECK(sim_cipher_buffer(p, got, len, lkey, nkey, &done), 0);
+		CHECK((int)done, len);
+		CHECK(memcmp(got, ref, len), 0);
+	}
+	CHECK(sim_cipher_buffer(p, NULL, 16, 1, 1, NULL), EFAULT);
+	CHECK(sim_cipher_buffer(p, got, (size_t)-1, 1, 1, NULL), EINVAL);
+	free(ref);
+	free(got);
+	sim_exit(p);
+}
+
+/*
+ * sys_cipher_vector() with shared and per-buffer keys against cipher_apply()
+ * on each buffer, and a bad buffer in the middle of the batch.
+ */
+static void
+check_vector(void)
+{
+	struct proc *p = sim_fork(NULL);
+	struct cipher_vec vec[64];
+	unsigned int seed = 5;
+	char ref[64][300], got[64][300];
+	int i, own, n = 64, ok;
+
+	for (own = 0; own < 2; own++) {
+		for (i = 0; i < n; i++) {
+			vec[i].cv_base = got[i];
+			vec[i].cv_len = (i < 8) ? i : rand_r(&seed) % 300;
+			vec[i].cv_lkey = keys[rand_r(&seed) % NKEYS];
+			vec[i].cv_nkey = keys[rand_r(&seed) % NKEYS];
+			vec[i].cv_done = 12345;
+			vec[i].cv_error = -1;
+			fill_random(ref[i], vec[i].cv_len, &seed);
+			memcpy(got[i], ref[i], vec[i].cv_len);
+			cipher_apply(ref[i], vec[i].cv_len, own ?
+			    substitution_table(vec[i].cv_lkey, vec[i].cv_nkey) :
+			    substitution_table(-3, 7));
+		}
+		vec[n / 2].cv_base = NULL;
+		CHECK(sim_cipher_vector(p, vec, n, own ? CIPHER_OWNKEYS : 0,
+		    -3, 7, &ok), 0);
+		CHECK(ok, n - 1);
+		for (i = 0; i < n; i++) {
+			if (i == n / 2) {
+				CHECK(vec[i].cv_error,
+				    vec[i].cv_len ? EFAULT : 0);
+				CHECK((int)vec[i].cv_done, 0);
+				continue;
+			}
+			CHECK(vec[i].cv_error, 0);
+			CHECK((int)vec[i].cv_done, (int)vec[i].cv_len);
+			CHECK(memcmp(got[i], ref[i], vec[i].cv_len), 0);
+		}
+	}
+
+	CHECK(sim_cipher_vector(p, vec, 0, 0, 1, 1, &ok), 0);
+	CHECK(ok, 0);
+	CHECK(sim_cipher_vector(p, vec, -1, 0, 1, 1, NULL), EINVAL);
+	CHECK(sim_cipher_vector(p, vec, CIPHER_VEC_MAX + 1, 0, 1, 1, NULL),
+	    EINVAL);
+	CHECK(sim_cipher_vector(p, vec, 1, 0x80, 1, 1, NULL), EINVAL);
+	CHECK(sim_cipher_vector(p, NULL, 1, 0, 1, 1, NULL), EFAULT);
+	sim_exit(p);
+}
+
+/*
+ * Deciphering must undo ciphering and the other way round, for every byte
+ * value, every key in keys[] and lengths with each size of short quad.
+ * sys_cipher() strings whose NUL comes back last round trip as well.
+ */
+static void
+check_decipher(void)
+{
+	struct proc *p = sim_fork(NULL);
+	struct cipher_vec vec[NKEYS];
+	unsigned char *map, *inv;
+	char orig[2100], buf[2100], bufs[NKEYS][64];
+	unsigned int seed = 6;
+	size_t done;
+	int i, j, len, ok;
+
+	for (i = 0; i < NKEYS; i++)
+		for (j = 0; j < NKEYS; j++) {
+			map = substitution_table(keys[i], keys[j]);
+			inv = inverse_table(keys[i], keys[j]);
+			for (len = 0; len < 256; len++)
+				CHECK(inv[map[len]], len);
+		}
+
+	for (i = 0; i < 200; i++) {
+		len = (i < 16) ? i : rand_r(&seed) % sizeof(orig);
+		fill_random(orig, len, &seed);
+		memcpy(buf, orig, len);
+		j = rand_r(&seed) % NKEYS;
+		CHECK(sim_cipher_buffer(p, buf, len, keys[j],
+		    keys[NKEYS - 1 - j], NULL), 0);
+		CHECK(sim_decipher_buffer(p, buf, len, keys[j],
+		    keys[NKEYS - 1 - j], &done), 0);
+		CHECK((int)done, len);
+		CHECK(memcmp(buf, orig, len), 0);
+		CHECK(sim_decipher_buffer(p, buf, len, keys[j], keys[j], NULL),
+		    0);
+		CHECK(sim_cipher_buffer(p, buf, len, keys[j], keys[j], NULL),
+		    0);
+		CHECK(memcmp(buf, orig, len), 0);
+	}
+
+	/* "Hello, World" is 12 chars: its NUL is a lone last char */
+	for (i = 0; i < NKEYS; i++) {
+		strcpy(buf, "Hello, World");
+		CHECK(sim_cipher(p, buf, keys[i], 7, NULL), 0);
+		CHECK(sim_decipher_buffer(p, buf, strlen(buf), keys[i], 7,
+		    NULL), 0);
+		CHECK(strcmp(buf, "Hello, World"), 0);
+	}
+
+	/* and batched, each buffer with its own keys */
+	for (i = 0; i < NKEYS; i++) {
+		vec[i].cv_base = bufs[i];
+		vec[i].cv_len = i;
+		vec[i].cv_lkey = keys[i];
+		vec[i].cv_nkey = keys[NKEYS - 1 - i];
+		fill_random(bufs[i], i, &seed);
+		memcpy(orig + 64 * i, bufs[i], i);
+	}
+	CHECK(sim_cipher_vector(p, vec, NKEYS, CIPHER_OWNKEYS, 0, 0, &ok), 0);
+	CHECK(ok, (int)NKEYS);
+	CHECK(sim_cipher_vector(p, vec, NKEYS, CIPHER_OWNKEYS | CIPHER_INVERSE,
+	    0, 0, &ok), 0);
+	CHECK(ok, (int)NKEYS);
+	for (i = 0; i < NKEYS; i++)
+		CHECK(memcmp(bufs[i], orig + 64 * i, i), 0);
+	sim_exit(p);
+}
+
+/* --------- BENCHMARKS --------- */
+
+static void
+report(const char *bench, const char *params, double bytes, double secs)
+{
+	printf("bench=%s %sbytes=%.0f ns_per_byte=%.3f bytes_per_sec=%.0f\n",
+	    bench, params, bytes, secs * 1e9 / bytes, bytes / secs);
+	fflush(stdout);
+}
+
+/*
+ * Substitution over a large buffer of printable text, per character or
+ * through the table; keys are cycled so the cache lookup is paid on every
+ * pass but always hits.
+ */
+static void
+bench_substitute(int size, int table)
+{
+	char params[64], *buf;
+	unsigned int seed = 1;
+	double t, total;
+	int i, passes;
+
+	if ((buf = malloc(size)) == NULL) {
+		perror("malloc");
+		exit(1);
+	}
+	for (i = 0; i < size; i++)
+		buf[i] = ' ' + rand_r(&seed) % 95;
+	passes = (256 << 20) / size;
+	t = now();
+	for (i = 0; i < passes; i++) {
+		if (table)
+			substitution_apply(buf, size,
+			    substitution_table(3 - i % 2, 7));
+		else
+			substitution(buf, size, 3 - i % 2, 7);
+	}
+	t = now() - t;
+	total = (double)passes * size;
+	snprintf(params, sizeof(params), "method=%s size=%d ",
+	    table ? "table" : "branch", size);
+	report("substitute", params, total, t);
+	free(buf);
+}
+
+/* Transposition over a large buffer, a byte swap or a word at a time */
+static void
+bench_transpose(int size, int word)
+{
+	char params[64], *buf;
+	unsigned int seed = 1;
+	double t, total;
+	int i, passes;
+
+	if ((buf = malloc(size)) == NULL) {
+		perror("malloc");
+		exit(1);
+	}
+	fill_random(buf, size, &seed);
+	passes = (256 << 20) / size;
+	t = now();
+	for (i = 0; i < passes; i++) {
+		if (word)
+			transposition(buf, size, 0, 0);
+		else
+			transpose_bytes(buf, size);
+	}
+	t = now() - t;
+	total = (double)passes * size;
+	snprintf(params, sizeof(params), "method=%s size=%d ",
+	    word ? "word" : "byte", size);
+	report("transpose", params, total, t);
+	free(buf);
+}
+
+/* Both passes over a large buffer, one after the other or fused */
+static void
+bench_cipher(int size, int fused)
+{
+	char params[64], *buf;
+	unsigned int seed = 1;
+	double t, total;
+	int i, passes;
+
+	if ((buf = malloc(size)) == NULL) {
+		perror("malloc");
+		exit(1);
+	}
+	fill_random(buf, size, &seed);
+	passes = (256 << 20) / size;
+	t = now();
+	for (i = 0; i < passes; i++) {
+		if (fused)
+			cipher_apply(buf, size, substitution_table(3, 7));
+		else {
+			substitution_apply(buf, size, substitution_table(3, 7));
+			transposition(buf, size, 3, 7);
+		}
+	}
+	t = now() - t;
+	total = (double)passes * size;
+	snprintf(params, sizeof(params), "method=%s size=%d ",
+	    fused ? "fused" : "twopass", size);
+	report("cipher", params, total, t);
+	free(buf);
+}
+
+/*
+ * Whole system calls: sys_cipher() on a string of `size' chars against
+ * sys_cipher_buffer() and sys_decipher_buffer() on the same bytes.  With
+ * size a multiple of 4 the string's NUL is the lone char of the last quad
+ * and stays put, so every sys_cipher() call sees the full length.
+ */
+static void
+bench_syscall(int size, int call)
+{
+	struct proc *p = sim_fork(NULL);
+	char params[64], *buf;
+	unsigned int seed = 1;
+	double t, total;
+	int i, passes;
+
+	if ((buf = malloc(size + 1)) == NULL) {
+		perror("malloc");
+		exit(1);
+	}
+	for (i = 0; i < size; i++)
+		buf[i] = ' ' + rand_r(&seed) % 95;
+	buf[size] = '\0';
+	passes = (64 << 20) / size;
+	t = now();
+	for (i = 0; i < passes; i++) {
+		if (call == 2)
+			sim_decipher_buffer(p, buf, size, 3, 7, NULL);
+		else if (call == 1)
+			sim_cipher_buffer(p, buf, size, 3, 7, NULL);
+		else
+			sim_cipher(p, buf, 3, 7, NULL);
+	}
+	t = now() - t;
+	total = (double)passes * size;
+	snprintf(params, sizeof(params), "call=%s size=%d ",
+	    call == 2 ? "decipher_buffer" : call ? "cipher_buffer" : "cipher",
+	    size);
+	report("syscall", params, total, t);
+	free(buf);
+	sim_exit(p);
+}
+
+/*
+ * A batch of short records: one sys_cipher_buffer() per record against one
+ * sys_cipher_vector() for the lot.
+ */
+static void
+bench_records(int size, int nrec, int vector)
+{
+	struct proc *p = sim_fork(NULL);
+	struct cipher_vec *vec;
+	char params[64], *buf;
+	unsigned int seed = 1;
+	double t, total;
+	int i, j, passes;
+
+	buf = malloc((size_t)size * nrec);
+	vec = calloc(nrec, sizeof(*vec));
+	if (buf == NULL || vec == NULL) {
+		perror("malloc");
+		exit(1);
+	}
+	fill_random(buf, size * nrec, &seed);
+	for (j = 0; j < nrec; j++) {
+		vec[j].cv_base = buf + j * size;
+		vec[j].cv_len = size;
+	}
+	passes = (64 << 20) / (size * nrec);
+	t = now();
+	for (i = 0; i < passes; i++) {
+		if (vector)
+			sim_cipher_vector(p, vec, nrec, 0, 3, 7, NULL);
+		else
+			for (j = 0; j < nrec; j++)
+				sim_cipher_buffer(p, buf + j * size, size, 3, 7,
+				    NULL);
+	}
+	t = now() - t;
+	total = (double)passes * size * nrec;
+	snprintf(params, sizeof(params), "call=%s size=%d records=%d "
+	    "ns_per_record=%.1f ", vector ? "cipher_vector" : "cipher_buffer",
+	    size, nrec, t * 1e9 / ((double)passes * nrec));
+	report("records", params, total, t);
+	free(vec);
+	free(buf);
+	sim_exit(p);
+}
+
+/*
+ * One implementation over buffers of `size' bytes: the reference, the
+ * original two passes, the fused pass or sys_cipher_buffer().
+ */
+static void
+bench_sweep(int size, int method)
+{
+	static const char *names[] = { "reference", "branch", "fused",
+	    "syscall" };
+	struct proc *p = sim_fork(NULL);
+	char params[64], *buf;
+	unsigned int seed = 1;
+	double t, total;
+	int i, passes;
+
+	if ((buf = malloc(size)) == NULL) {
+		perror("malloc");
+		exit(1);
+	}
+	for (i = 0; i < size; i++)
+		buf[i] = ' ' + rand_r(&seed) % 95;
+	passes = (16 << 20) / size;
+	t = now();
+	for (i = 0; i < passes; i++) {
+		switch (method) {
+		case 0:
+			ref_cipher(buf, size, 3, 7);
+			break;
+		case 1:
+			substitution(buf, size, 3, 7);
+			transposition(buf, size, 3, 7);
+			break;
+		case 2:
+			cipher_apply(buf, size, substitution_table(3, 7));
+			break;
+		default:
+			sim_cipher_buffer(p, buf, size, 3, 7, NULL);
+			break;
+		}
+	}
+	t = now() - t;
+	total = (double)passes * size;
+	snprintf(params, sizeof(params), "method=%s size=%d ", names[method],
+	    size);
+	report("sweep", params, total, t);
+	free(buf);
+	sim_exit(p);
+}
+
+int
+main(int argc, char *argv[])
+{
+	unsigned int seed = time(NULL);
+	int quick = 0, rounds = 20000, ch, size, method;
+
+	while ((ch = getopt(argc, argv, "qn:s:")) != -1) {
+		switch (ch) {
+		case 'q':
+			quick = 1;
+			break;
+		case 'n':
+			rounds = atoi(optarg);
+			break;
+		case 's':
+			seed = strtoul(optarg, NULL, 0);
+			break;
+		default:
+			fprintf(stderr, "usage: ciphersim [-q] [-n rounds] "
+			    "[-s seed]\n");
+			return (1);
+		}
+	}
+	sim_init();
+
+	check_reference();
+	check_fuzz(rounds, seed);
+	check_table();
+	check_transpose();
+	check_fused();
+	check_syscall();
+	check_buffer();
+	check_vector();
+	check_decipher();
+
+	if (!quick) {
+		bench_substitute(1024, 0);
+		bench_substitute(1024, 1);
+		bench_substitute(1 << 20, 0);
+		bench_substitute(1 << 20, 1);
+		bench_transpose(1024, 0);
+		bench_transpose(1024, 1);
+		bench_transpose(1 << 20, 0);
+		bench_transpose(1 << 20, 1);
+		bench_cipher(1024, 0);
+		bench_cipher(1024, 1);
+		bench_cipher(1 << 20, 0);
+		bench_cipher(1 << 20, 1);
+		bench_syscall(1020, 0);
+		bench_syscall(1020, 1);
+		bench_syscall(1 << 20, 1);
+		bench_syscall(1 << 20, 2);
+		bench_records(64, 1024, 0);
+		bench_records(64, 1024, 1);
+		for (size = 1; size <= (1 << 20); size <<= 2)
+			for (method = 0; method < 4; method++)
+				bench_sweep(size, method);
+	}
+
+	printf("%s\n", failures ? "FAIL" : "ok");
+	return (failures != 0);
+}
@@ -0,0 +1,1089 @@
+/*
+ * Kernel services for the semaphore simulation harness.
+ *
+ * Processes are plain struct procs arranged in a tree under a simulated
+ * init; threads stand in for them and enter the system calls through the
+ * sim_*() wrappers.  A single giant mutex is held for the whole of every
+ * system call and released only while asleep in tsleep(), so the code in
+ * cop4600.c sees the same non-preemptive scheduling it gets from the
+ * OpenBSD 3.5 kernel.
+ */
+
+#include <sys/param.h>
+#include <sys/systm.h>
+#include <sys/proc.h>
+#include <sys/malloc.h>
+#include <sys/syscallargs.h>
+
+#include <uvm/uvm_extern.h>
+
+#undef malloc			/* the host allocator backs malloc(9) */
+#undef free
+
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "sim.h"
+
+__thread struct proc *sim_curproc;
+
+static pthread_mutex_t giant = PTHREAD_MUTEX_INITIALIZER;
+static LIST_HEAD(, proc) allproc = LIST_HEAD_INITIALIZER(allproc);
+static struct proc initproc;
+static struct pgrp initpgrp;
+static struct ucred rootcred = { 1, 0, 0, 1, { 0 } };
+static struct pcred initcred = { &rootcred };
+static pid_t nextpid = 2;
+static unsigned long nallocated;
+
+/* cop4600.c's group and global namespaces; keep in step with it */
+#define SEM_HASH_SIZE	64
+LIST_HEAD(sem_hashhead, semaphore);
+extern struct sem_hashhead sem_pgrphash[SEM_HASH_SIZE];
+extern struct sem_hashhead sem_globalhash[SEM_HASH_SIZE];
+
+/*
+ * A thread blocked in tsleep().  Sleepers are kept on one global list;
+ * wakeup() marks every sleeper on the channel and signals it.
+ */
+struct sleeper {
+	void		*chan;
+	int		 woken;
+	pthread_cond_t	 cv;
+	struct sleeper	*next;
+};
+static struct sleeper *sleepq;
+
+/* --------- KERNEL SUPPORT ROUTINES --------- */
+
+/*
+ * malloc(9) hands out power-of-two buckets aligned to their size; keep
+ * blocks of a cache line or more line aligned so layouts that rely on it
+ * (semaphore_t) see the same placement here.
+ */
+void *
+sim_malloc(unsigned long size, int type, int flags)
+{
+	void *addr;
+
+	if (size >= 64) {
+		if (posix_memalign(&addr, 64, size) != 0)
+			addr = NULL;
+		else if (flags & M_ZERO)
+			memset(addr, 0, size);
+	} else
+		addr = (flags & M_ZERO) ? calloc(1, size) : malloc(size);
+	if (addr != NULL)
+		__atomic_add_fetch(&nallocated, 1, __ATOMIC_RELAXED);
+	return (addr);
+}
+
+void
+sim_free(void *addr, int type)
+{
+	if (addr == NULL)
+		panic("free: NULL");
+	__atomic_sub_fetch(&nallocated, 1, __ATOMIC_RELAXED);
+	free(addr);
+}
+
+unsigned long
+sim_allocated(void)
+{
+	return (__atomic_load_n(&nallocated, __ATOMIC_RELAXED));
+}
+
+static void
+setdone(void *done, size_t width, size_t len)
+{
+	if (done == NULL)
+		return;
+	if (width == sizeof(int))
+		*(int *)done = len;
+	else
+		*(size_t *)done = len;
+}
+
+static int
+copystr1(const void *from, void *to, size_t max, void *done, size_t width)
+{
+	const char *f = from;
+	char *t = to;
+	size_t len;
+
+	if (from == NULL || to == NULL)
+		return (EFAULT);
+	for (len = 0; len < max; len++)
+		if ((*t++ = *f++) == '\0') {
+			setdone(done, width, len + 1);
+			return (0);
+		}
+	setdone(done, width, len);
+	return (ENAMETOOLONG);
+}
+
+int
+sim_copyinstr(const void *from, void *to, size_t max, void *done, size_t width)
+{
+	return (copystr1(from, to, max, done, width));
+}
+
+int
+sim_copyoutstr(const void *from, void *to, size_t max, void *done, size_t width)
+{
+	return (copystr1(from, to, max, done, width));
+}
+
+int
+sim_copystr(const void *from, void *to, size_t max, void *done, size_t width)
+{
+	return (copystr1(from, to, max, done, width));
+}
+
+int
+copyin(const void *uaddr, void *kaddr, size_t len)
+{
+	if (uaddr == NULL)
+		return (EFAULT);
+	memcpy(kaddr, uaddr, len);
+	return (0);
+}
+
+int
+copyout(const void *kaddr, void *uaddr, size_t len)
+{
+	if (uaddr == NULL)
+		return (EFAULT);
+	memcpy(uaddr, kaddr, len);
+	return (0);
+}
+
+int
+uvm_useracc(caddr_t addr, size_t len, int rw)
+{
+	return (addr != NULL);
+}
+
+/* simple locks held by the calling thread; must be none in tsleep() */
+static __thread int simple_locks_held;
+
+void
+simple_lock_init(struct simplelock *alp)
+{
+	alp->lock_data = 0;
+}
+
+void
+simple_lock(struct simplelock *alp)
+{
+	if (alp->lock_data != 0)
+		panic("simple_lock: %p already held", alp);
+	alp->lock_data = 1;
+	simple_locks_held++;
+}
+
+void
+simple_unlock(struct simplelock *alp)
+{
+	if (alp->lock_data == 0)
+		panic("simple_unlock: %p not held", alp);
+	alp->lock_data = 0;
+	simple_locks_held--;
+}
+
+/*
+ * Scheduler hooks.  There is no p_estcpu to decay, so the user priority
+ * follows from the nice value alone; and no run queues, since every
+ * process is a host thread the host schedules.
+ */
+void
+resetpriority(struct proc *p)
+{
+	int newpriority;
+
+	newpriority = PUSER + 2 * p->p_nice;	/* NICE_WEIGHT */
+	p->p_usrpri = newpriority < MAXPRI ? newpriority : MAXPRI;
+}
+
+void
+remrunqueue(struct proc *p)
+{
+}
+
+void
+setrunqueue(struct proc *p)
+{
+}
+
+int
+tsleep(void *chan, int pri, const char *wmesg, int timo)
+{
+	struct sleeper s, **sp;
+	struct timespec ts;
+	int error = 0;
+
+	if (simple_locks_held != 0)
+		panic("tsleep: \"%s\" with %d simple locks held", wmesg,
+		    simple_locks_held);
+	s.chan = chan;
+	s.woken = 0;
+	pthread_cond_init(&s.cv, NULL);
+	s.next = sleepq;
+	sleepq = &s;
+
+	if (timo > 0) {
+		clock_gettime(CLOCK_REALTIME, &ts);
+		ts.tv_nsec += (long)timo * (1000000000L / hz);
+		ts.tv_sec += ts.tv_nsec / 1000000000L;
+		ts.tv_nsec %= 1000000000L;
+	}
+	while (!s.woken && error == 0) {
+		if (timo > 0)
+			error = pthread_cond_timedwait(&s.cv, &giant, &ts);
+		else
+			pthread_cond_wait(&s.cv, &giant);
+	}
+	if (!s.woken) {
+		for (sp = &sleepq; *sp != &s; sp = &(*sp)->next)
+			;
+		*sp = s.next;
+		error = EWOULDBLOCK;
+	} else
+		error = 0;
+	pthread_cond_destroy(&s.cv);
+	return (error);
+}
+
+void
+wakeup(void *chan)
+{
+	struct sleeper **sp, *s;
+
+	for (sp = &sleepq; (s = *sp) != NULL; ) {
+		if (s->chan == chan) {
+			*sp = s->next;
+			s->woken = 1;
+			pthread_cond_signal(&s->cv);
+		} else
+			sp = &s->next;
+	}
+}
+
+/* As kern_event.c: run each note's filter and activate it if it fires */
+void
+knote(struct klist *list, long hint)
+{
+	struct knote *kn;
+
+	SLIST_FOREACH(kn, list, kn_selnext)
+		if (kn->kn_fop->f_event(kn, hint))
+			kn->kn_status |= KN_ACTIVE;
+}
+
+void
+uprintf(const char *fmt, ...)
+{
+	va_list ap;
+
+	va_start(ap, fmt);
+	vprintf(fmt, ap);
+	va_end(ap);
+}
+
+int
+groupmember(gid_t gid, struct ucred *cred)
+{
+	int i;
+
+	if (cred->cr_gid == gid)
+		return (1);
+	for (i = 0; i < cred->cr_ngroups; i++)
+		if (cred->cr_groups[i] == gid)
+			return (1);
+	return (0);
+}
+
+void
+panic(const char *fmt, ...)
+{
+	va_list ap;
+
+	fprintf(stderr, "panic: ");
+	va_start(ap, fmt);
+	vfprintf(stderr, fmt, ap);
+	va_end(ap);
+	fprintf(stderr, "\n");
+	abort();
+}
+
+/* --------- PROCESS TREE --------- */
+
+void
+sim_init(void)
+{
+	initproc.p_pid = 1;
+	initproc.p_stat = SRUN;
+	initproc.p_priority = PUSER;
+	initproc.p_usrpri = PUSER;
+	initproc.p_cred = &initcred;
+	initpgrp.pg_id = 1;
+	LIST_INIT(&initpgrp.pg_members);
+	LIST_INSERT_HEAD(&initpgrp.pg_members, &initproc, p_pglist);
+	initproc.p_pgrp = &initpgrp;
+	LIST_INIT(&initproc.p_children);
+	LIST_INIT(&initproc.semaphores);
+	LIST_INIT(&initproc.p_semheld);
+	initproc.inherited = 0;
+	LIST_INSERT_HEAD(&allproc, &initproc, p_list);
+}
+
+/* Mirrors the semaphore and family bookkeeping of fork1() */
+struct proc *
+sim_fork(struct proc *p1)
+{
+	struct proc *p2;
+
+	if (p1 == NULL)
+		p1 = &initproc;
+	if ((p2 = calloc(1, sizeof(*p2))) == NULL)
+		panic("sim_fork: out of memory");
+
+	pthread_mutex_lock(&giant);
+	p2->p_pid = nextpid++;
+	LIST_INSERT_HEAD(&allproc, p2, p_list);
+	p2->p_stat = SRUN;
+	p2->p_priority = p1->p_priority;
+	p2->p_usrpri = p1->p_usrpri;
+	p2->p_nice = p1->p_nice;
+	p2->p_cred = p1->p_cred;	/* shared, like crhold() */
+	p2->p_ucred->cr_ref++;
+	p2->p_pgrp = p1->p_pgrp;
+	LIST_INSERT_AFTER(p1, p2, p_pglist);
+	p2->p_pptr = p1;
+	LIST_INSERT_HEAD(&p1->p_children, p2, p_sibling);
+	LIST_INIT(&p2->p_children);
+
+	LIST_INIT(&p2->semaphores);
+	LIST_INIT(&p2->p_semheld);
+	/* nothing to inherit: the parent neither owns nor inherited any */
+	if (LIST_EMPTY(&p1->semaphores) && !p1->inherited)
+		p2->inherited = 0;
+	else					/* child should inherit parent's semaphores */
+		p2->inherited = 1;
+	pthread_mutex_unlock(&giant);
+	return (p2);
+}
+
+/* Mirrors leavepgrp()/pgdelete() */
+static void
+leavepgrp(struct proc *p)
+{
+	struct pgrp *pg = p->p_pgrp;
+
+	LIST_REMOVE(p, p_pglist);
+	p->p_pgrp = NULL;
+	if (LIST_EMPTY(&pg->pg_members) && pg != &initpgrp) {
+		pgrp_semaphores(pg);
+		free(pg);
+	}
+}
+
+void
+sim_setpgrp(struct proc *p)
+{
+	struct pgrp *pg;
+
+	if ((pg = calloc(1, sizeof(*pg))) == NULL)
+		panic("sim_setpgrp: out of memory");
+	pthread_mutex_lock(&giant);
+	pg->pg_id = p->p_pid;
+	LIST_INIT(&pg->pg_members);
+	leavepgrp(p);
+	LIST_INSERT_HEAD(&pg->pg_members, p, p_pglist);
+	p->p_pgrp = pg;
+	pthread_mutex_unlock(&giant);
+}
+
+static void
+crfree(struct proc *p)
+{
+	if (--p->p_ucred->cr_ref == 0)
+		free(p->p_cred);
+}
+
+/* Give p credentials of its own, released with its last reference */
+void
+sim_setcred(struct proc *p, int uid, int gid)
+{
+	struct pcred *pc;
+
+	if ((pc = calloc(1, sizeof(*pc) + sizeof(*pc->pc_ucred))) == NULL)
+		panic("sim_setcred: out of memory");
+	pc->pc_ucred = (struct ucred *)(pc + 1);
+	pc->pc_ucred->cr_ref = 1;
+	pc->pc_ucred->cr_uid = uid;
+	pc->pc_ucred->cr_gid = gid;
+	pc->pc_ucred->cr_ngroups = 1;
+	pc->pc_ucred->cr_groups[0] = gid;
+	pthread_mutex_lock(&giant);
+	crfree(p);
+	p->p_cred = pc;
+	pthread_mutex_unlock(&giant);
+}
+
+/*
+ * Mirrors the semaphore teardown and reparenting done by exit1(); the
+ * process is reaped (and leaves its group) straight away.
+ */
+void
+sim_exit(struct proc *p)
+{
+	struct proc *q;
+
+	pthread_mutex_lock(&giant);
+	sim_curproc = p;
+	p->p_flag |= P_WEXIT;
+	exit_semaphores(p);
+	while ((q = LIST_FIRST(&p->p_children)) != NULL) {
+		LIST_REMOVE(q, p_sibling);
+		LIST_INSERT_HEAD(&initproc.p_children, q, p_sibling);
+		q->p_pptr = &initproc;
+	}
+	LIST_REMOVE(p, p_sibling);
+	LIST_REMOVE(p, p_list);
+	leavepgrp(p);
+	crfree(p);
+	sim_curproc = NULL;
+	pthread_mutex_unlock(&giant);
+	free(p);
+}
+
+/* Whether a thread is asleep in tsleep() on chan */
+static int
+asleep(void *chan)
+{
+	struct sleeper *s;
+
+	for (s = sleepq; s != NULL; s = s->next)
+		if (s->chan == chan)
+			return (1);
+	return (0);
+}
+
+/* Check one slot's wait queue against its count; returns the violations */
+static int
+audit_slot(semaphore_t *sem, int i, pid_t pid)
+{
+	struct sem_slot *slot = &sem->slot[i];
+	struct p_node *np;
+	int bad = 0, n = 0, retry = 0, want;
+
+	SIMPLEQ_FOREACH(np, &slot->p_head, p_next) {
+		n++;
+		if (np->state == P_NODE_RETRY) {
+			retry++;	/* woken to compete, still queued */
+			continue;
+		}
+		if (!asleep(np->group != NULL ? np->group : np)) {
+			fprintf(stderr, "audit: pid %d queued on %s[%d]/%d "
+			    "but awake\n", np->p->p_pid, sem->name, i, pid);
+			bad++;
+		}
+	}
+	if (sem->type == SEM_TYPE_CHANNEL && i == SEM_CHAN_ITEMS) {
+		struct sem_ring *r = sem->ring;
+		int items = MAX(sem->slot[SEM_CHAN_ITEMS].count, 0);
+		int space = MAX(sem->slot[SEM_CHAN_SPACE].count, 0);
+
+		/* posted receivers and senders may still owe the ring a record */
+		if (r->used < items || r->capacity - r->used < space) {
+			fprintf(stderr, "audit: channel %s/%d holds %d of %d "
+			    "with %d to receive, %d free\n", sem->name, pid,
+			    r->used, r->capacity, items, space);
+			bad++;
+		}
+	}
+	if (sem->flags & SEM_MUTEX) {
+		if ((slot->count > 0) != (sem->holder == NULL)) {
+			fprintf(stderr, "audit: mutex %s/%d count %d, holder "
+			    "%d\n", sem->name, pid, slot->count,
+			    sem->holder != NULL ? sem->holder->p_pid : 0);
+			bad++;
+		}
+		SIMPLEQ_FOREACH(np, &slot->p_head, p_next)
+			if (np->state == P_NODE_WAITING && sem->holder != NULL &&
+			    sem->holder->p_usrpri > np->p->p_priority) {
+				fprintf(stderr, "audit: mutex %s/%d holder %d "
+				    "at %d not lent %d by pid %d\n", sem->name,
+				    pid, sem->holder->p_pid,
+				    sem->holder->p_usrpri, np->p->p_priority,
+				    np->p->p_pid);
+				bad++;
+			}
+	}
+	if (sem->flags & SEM_BARGE) {
+		/*
+		 * Sleepers are not charged; every unit put back while someone
+		 * sleeps must have woken a retry that has not yet run.
+		 */
+		if (slot->count < 0 ||
+		    (n > retry && slot->count > retry)) {
+			fprintf(stderr, "audit: %s[%d]/%d barging count %d "
+			    "with %d waiters, %d retrying\n", sem->name, i,
+			    pid, slot->count, n, retry);
+			bad++;
+		}
+		return (bad);
+	}
+	if (sem->type == SEM_TYPE_BARRIER)
+		want = sem->parties - slot->count;
+	else
+		want = slot->count < 0 ? -slot->count : 0;
+	if (n != want) {
+		fprintf(stderr, "audit: %s[%d]/%d count %d with %d waiters\n",
+		    sem->name, i, pid, slot->count, n);
+		bad++;
+	}
+	return (bad);
+}
+
+/*
+ * Check the wait queue of every slot of every semaphore, process-owned or
+ * in the group and global namespaces, against its count: at rest a slot
+ * with count c < 0 has exactly -c waiters queued (a barrier: parties - c),
+ * and every queued waiter is really asleep.  A violation is a lost or
+ * spurious wakeup.  Returns the number of violations, each reported on
+ * stderr; group semaphores are reported under the group id, global ones
+ * under 0.
+ */
+int
+sim_audit(void)
+{
+	struct proc *p;
+	semaphore_t *sem;
+	int bad = 0, h, i;
+
+	pthread_mutex_lock(&giant);
+	LIST_FOREACH(p, &allproc, p_list)
+		LIST_FOREACH(sem, &p->semaphores, s_next)
+			for (i = 0; i < sem->nsems; i++)
+				bad += audit_slot(sem, i, p->p_pid);
+	for (h = 0; h < SEM_HASH_SIZE; h++) {
+		LIST_FOREACH(sem, &sem_pgrphash[h], s_next)
+			for (i = 0; i < sem->nsems; i++)
+				bad += audit_slot(sem, i, sem->pgrp->pg_id);
+		LIST_FOREACH(sem, &sem_globalhash[h], s_next)
+			for (i = 0; i < sem->nsems; i++)
+				bad += audit_slot(sem, i, 0);
+	}
+	pthread_mutex_unlock(&giant);
+	return (bad);
+}
+
+int
+sim_pid(struct proc *p)
+{
+	return (p->p_pid);
+}
+
+/* Mirrors donice() */
+void
+sim_setnice(struct proc *p, int nice)
+{
+	pthread_mutex_lock(&giant);
+	p->p_nice = nice;
+	resetpriority(p);
+	p->p_priority = p->p_usrpri;
+	pthread_mutex_unlock(&giant);
+}
+
+int
+sim_priority(struct proc *p)
+{
+	int pri;
+
+	pthread_mutex_lock(&giant);
+	pri = p->p_usrpri;
+	pthread_mutex_unlock(&giant);
+	return (pri);
+}
+
+/* --------- SYSTEM CALL ENTRY --------- */
+
+/* set between sim_enter() and sim_leave(): giant is held across calls */
+static __thread int sim_entered;
+
+void
+sim_enter(void)
+{
+	pthread_mutex_lock(&giant);
+	sim_entered = 1;
+}
+
+void
+sim_leave(void)
+{
+	sim_entered = 0;
+	pthread_mutex_unlock(&giant);
+}
+
+static int
+sim_syscall(struct proc *p, int (*call)(struct proc *, void *, register_t *),
+    void *args, register_t *retval)
+{
+	register_t rv = 0;
+	int error;
+
+	if (!sim_entered)
+		pthread_mutex_lock(&giant);
+	sim_curproc = p;
+	error = (*call)(p, args, &rv);
+	p->p_priority = p->p_usrpri;	/* userret() */
+	sim_curproc = NULL;
+	if (!sim_entered)
+		pthread_mutex_unlock(&giant);
+	if (retval != NULL)
+		*retval = rv;
+	return (error);
+}
+
+int
+sim_null(struct proc *p)
+{
+	return (sim_syscall(p, sys_null, NULL, NULL));
+}
+
+int
+sim_null_args(struct proc *p, long a1, long a2, long a3, long a4, long a5,
+    long a6)
+{
+	struct sys_null_args_args args;
+
+	SCARG(&args, a1) = a1;
+	SCARG(&args, a2) = a2;
+	SCARG(&args, a3) = a3;
+	SCARG(&args, a4) = a4;
+	SCARG(&args, a5) = a5;
+	SCARG(&args, a6) = a6;
+	return (sim_syscall(p, sys_null_args, &args, NULL));
+}
+
+int
+sim_null_str(struct proc *p, const char *str, int *len)
+{
+	struct sys_null_str_args args;
+	register_t rv;
+	int error;
+
+	SCARG(&args, str) = str;
+	error = sim_syscall(p, sys_null_str, &args, &rv);
+	if (len != NULL)
+		*len = rv;
+	return (error);
+}
+
+int
+sim_allocate_semaphore(struct proc *p, const char *name, int count)
+{
+	struct sys_allocate_semaphore_args args;
+
+	SCARG(&args, name) = name;
+	SCARG(&args, initial_count) = count;
+	return (sim_syscall(p, sys_allocate_semaphore, &args, NULL));
+}
+
+int
+sim_down_semaphore(struct proc *p, const char *name)
+{
+	struct sys_down_semaphore_args args;
+
+	SCARG(&args, name) = name;
+	return (sim_syscall(p, sys_down_semaphore, &args, NULL));
+}
+
+int
+sim_up_semaphore(struct proc *p, const char *name)
+{
+	struct sys_up_semaphore_args args;
+
+	SCARG(&args, name) = name;
+	return (sim_syscall(p, sys_up_semaphore, &args, NULL));
+}
+
+int
+sim_free_semaphore(struct proc *p, const char *name)
+{
+	struct sys_free_semaphore_args args;
+
+	SCARG(&args, name) = name;
+	return (sim_syscall(p, sys_free_semaphore, &args, NULL));
+}
+
+int
+sim_allocate_semaphore_scope(struct proc *p, const char *name, int count,
+    int scope)
+{
+	struct sys_allocate_semaphore_scope_args args;
+
+	SCARG(&args, name) = name;
+	SCARG(&args, initial_count) = count;
+	SCARG(&args, scope) = scope;
+	return (sim_syscall(p, sys_allocate_semaphore_scope, &args, NULL));
+}
+
+int
+sim_open_semaphore(struct proc *p, const char *name, int oflag, int mode,
+    int count)
+{
+	struct sys_open_semaphore_args args;
+
+	SCARG(&args, name) = name;
+	SCARG(&args, oflag) = oflag;
+	SCARG(&args, mode) = mode;
+	SCARG(&args, initial_count) = count;
+	return (sim_syscall(p, sys_open_semaphore, &args, NULL));
+}
+
+int
+sim_allocate_semaphore_set(struct proc *p, const char *name, int nsems,
+    int count)
+{
+	struct sys_allocate_semaphore_set_args args;
+
+	SCARG(&args, name) = name;
+	SCARG(&args, nsems) = nsems;
+	SCARG(&args, initial_count) = count;
+	return (sim_syscall(p, sys_allocate_semaphore_set, &args, NULL));
+}
+
+int
+sim_down_semaphore_index(struct proc *p, const char *name, int index)
+{
+	struct sys_down_semaphore_index_args args;
+
+	SCARG(&args, name) = name;
+	SCARG(&args, index) = index;
+	return (sim_syscall(p, sys_down_semaphore_index, &args, NULL));
+}
+
+int
+sim_up_semaphore_index(struct proc *p, const char *name, int index)
+{
+	struct sys_up_semaphore_index_args args;
+
+	SCARG(&args, name) = name;
+	SCARG(&args, index) = index;
+	return (sim_syscall(p, sys_up_semaphore_index, &args, NULL));
+}
+
+int
+sim_allocate_barrier(struct proc *p, const char *name, int parties)
+{
+	struct sys_allocate_barrier_args args;
+
+	SCARG(&args, name) = name;
+	SCARG(&args, parties) = parties;
+	return (sim_syscall(p, sys_allocate_barrier, &args, NULL));
+}
+
+int
+sim_wait_barrier(struct proc *p, const char *name, int *phase)
+{
+	struct sys_wait_barrier_args args;
+	register_t rv;
+	int error;
+
+	SCARG(&args, name) = name;
+	error = sim_syscall(p, sys_wait_barrier, &args, &rv);
+	if (phase != NULL)
+		*phase = rv;
+	return (error);
+}
+
+int
+sim_down_semaphore_any(struct proc *p, const char **names, int n, int *which)
+{
+	struct sys_down_semaphore_any_args args;
+	register_t rv;
+	int error;
+
+	SCARG(&args, names) = names;
+	SCARG(&args, nnames) = n;
+	error = sim_syscall(p, sys_down_semaphore_any, &args, &rv);
+	if (which != NULL)
+		*which = rv;
+	return (error);
+}
+
+int
+sim_allocate_semaphore_flags(struct proc *p, const char *name, int count,
+    int flags)
+{
+	struct sys_allocate_semaphore_flags_args args;
+
+	SCARG(&args, name) = name;
+	SCARG(&args, initial_count) = count;
+	SCARG(&args, flags) = flags;
+	return (sim_syscall(p, sys_allocate_semaphore_flags, &args, NULL));
+}
+
+int
+sim_allocate_channel(struct proc *p, const char *name, int capacity,
+    int msgsize)
+{
+	struct sys_allocate_channel_args args;
+
+	SCARG(&args, name) = name;
+	SCARG(&args, capacity) = capacity;
+	SCARG(&args, msgsize) = msgsize;
+	return (sim_syscall(p, sys_allocate_channel, &args, NULL));
+}
+
+int
+sim_channel_send(struct proc *p, const char *name, const void *msg, int len)
+{
+	struct sys_channel_send_args args;
+
+	SCARG(&args, name) = name;
+	SCARG(&args, msg) = msg;
+	SCARG(&args, len) = len;
+	return (sim_syscall(p, sys_channel_send, &args, NULL));
+}
+
+int
+sim_channel_receive(struct proc *p, const char *name, void *msg, int len,
+    int *got)
+{
+	struct sys_channel_receive_args args;
+	register_t rv;
+	int error;
+
+	SCARG(&args, name) = name;
+	SCARG(&args, msg) = msg;
+	SCARG(&args, len) = len;
+	error = sim_syscall(p, sys_channel_receive, &args, &rv);
+	if (got != NULL)
+		*got = rv;
+	return (error);
+}
+
+int
+sim_channel_send_batch(struct proc *p, const char *name, const void *msgs,
+    const int *lens, int n, int *sent)
+{
+	struct sys_channel_send_batch_args args;
+	register_t rv;
+	int error;
+
+	SCARG(&args, name) = name;
+	SCARG(&args, msgs) = msgs;
+	SCARG(&args, lens) = lens;
+	SCARG(&args, nmsgs) = n;
+	error = sim_syscall(p, sys_channel_send_batch, &args, &rv);
+	if (sent != NULL)
+		*sent = rv;
+	return (error);
+}
+
+int
+sim_channel_receive_batch(struct proc *p, const char *name, void *msgs,
+    int len, int *lens, int n, int *got)
+{
+	struct sys_channel_receive_batch_args args;
+	register_t rv;
+	int error;
+
+	SCARG(&args, name) = name;
+	SCARG(&args, msgs) = msgs;
+	SCARG(&args, len) = len;
+	SCARG(&args, lens) = lens;
+	SCARG(&args, nmsgs) = n;
+	error = sim_syscall(p, sys_channel_receive_batch, &args, &rv);
+	if (got != NULL)
+		*got = rv;
+	return (error);
+}
+
+int
+sim_allocate_condition(struct proc *p, const char *name)
+{
+	struct sys_allocate_condition_args args;
+
+	SCARG(&args, name) = name;
+	return (sim_syscall(p, sys_allocate_condition, &args, NULL));
+}
+
+int
+sim_wait_condition(struct proc *p, const char *name, const char *mutex)
+{
+	struct sys_wait_condition_args args;
+
+	SCARG(&args, name) = name;
+	SCARG(&args, mutex) = mutex;
+	return (sim_syscall(p, sys_wait_condition, &args, NULL));
+}
+
+int
+sim_signal_condition(struct proc *p, const char *name, int *woken)
+{
+	struct sys_signal_condition_args args;
+	register_t rv;
+	int error;
+
+	SCARG(&args, name) = name;
+	error = sim_syscall(p, sys_signal_condition, &args, &rv);
+	if (woken != NULL)
+		*woken = rv;
+	return (error);
+}
+
+int
+sim_broadcast_condition(struct proc *p, const char *name, int *woken)
+{
+	struct sys_broadcast_condition_args args;
+	register_t rv;
+	int error;
+
+	SCARG(&args, name) = name;
+	error = sim_syscall(p, sys_broadcast_condition, &args, &rv);
+	if (woken != NULL)
+		*woken = rv;
+	return (error);
+}
+
+int
+sim_cipher(struct proc *p, char *text, int lkey, int nkey, int *len)
+{
+	struct sys_cipher_args args;
+	register_t rv;
+	int error;
+
+	SCARG(&args, text) = text;
+	SCARG(&args, lkey) = lkey;
+	SCARG(&args, nkey) = nkey;
+	error = sim_syscall(p, sys_cipher, &args, &rv);
+	if (len != NULL)
+		*len = rv;
+	return (error);
+}
+
+int
+sim_cipher_buffer(struct proc *p, void *buf, size_t len, int lkey, int nkey,
+    size_t *done)
+{
+	struct sys_cipher_buffer_args args;
+	register_t rv;
+	int error;
+
+	SCARG(&args, buf) = buf;
+	SCARG(&args, len) = len;
+	SCARG(&args, lkey) = lkey;
+	SCARG(&args, nkey) = nkey;
+	error = sim_syscall(p, sys_cipher_buffer, &args, &rv);
+	if (done != NULL)
+		*done = rv;
+	return (error);
+}
+
+int
+sim_cipher_vector(struct proc *p, struct cipher_vec *vec, int nvec, int flags,
+    int lkey, int nkey, int *ok)
+{
+	struct sys_cipher_vector_args args;
+	register_t rv;
+	int error;
+
+	SCARG(&args, vec) = vec;
+	SCARG(&args, nvec) = nvec;
+	SCARG(&args, flags) = flags;
+	SCARG(&args, lkey) = lkey;
+	SCARG(&args, nkey) = nkey;
+	error = sim_syscall(p, sys_cipher_vector, &args, &rv);
+	if (ok != NULL)
+		*ok = rv;
+	return (error);
+}
+
+int
+sim_decipher_buffer(struct proc *p, void *buf, size_t len, int lkey, int nkey,
+    size_t *done)
+{
+	struct sys_decipher_buffer_args args;
+	register_t rv;
+	int error;
+
+	SCARG(&args, buf) = buf;
+	SCARG(&args, len) = len;
+	SCARG(&args, lkey) = lkey;
+	SCARG(&args, nkey) = nkey;
+	error = sim_syscall(p, sys_decipher_buffer, &args, &rv);
+	if (done != NULL)
+		*done = rv;
+	return (error);
+}
+
+/* --------- KEVENT --------- */
+
+/*
+ * kqueue_register() for one EVFILT_SEMAPHORE note on slot `index' of
+ * `name'.  The name is not copied: like a user kevent ident it must stay
+ * valid while the note is attached.
+ */
+struct knote *
+sim_kevent_attach(struct proc *p, const char *name, int index, int *error)
+{
+	struct knote *kn;
+
+	if ((kn = calloc(1, sizeof(*kn))) == NULL)
+		panic("sim_kevent_attach: out of memory");
+	kn->kn_id = (uintptr_t)name;
+	kn->kn_filter = EVFILT_SEMAPHORE;
+	kn->kn_sfflags = index;
+	kn->kn_fop = &sem_filtops;
+	pthread_mutex_lock(&giant);
+	sim_curproc = p;
+	*error = kn->kn_fop->f_attach(kn);
+	sim_curproc = NULL;
+	pthread_mutex_unlock(&giant);
+	if (*error != 0) {
+		free(kn);
+		return (NULL);
+	}
+	return (kn);
+}
+
+/*
+ * kqueue_scan() of one note: if it was activated since the last scan, run
+ * the filter again and report whether it still fires, with its data and
+ * EV_EOF.  The note is cleared either way.
+ */
+int
+sim_kevent_scan(struct knote *kn, long *data, int *eof)
+{
+	int fired = 0;
+
+	pthread_mutex_lock(&giant);
+	if (kn->kn_status & KN_ACTIVE) {
+		kn->kn_status &= ~KN_ACTIVE;
+		fired = kn->kn_fop->f_event(kn, 0);
+	}
+	if (data != NULL)
+		*data = kn->kn_data;
+	if (eof != NULL)
+		*eof = (kn->kn_flags & EV_EOF) != 0;
+	pthread_mutex_unlock(&giant);
+	return (fired);
+}
+
+void
+sim_kevent_detach(struct knote *kn)
+{
+	pthread_mutex_lock(&giant);
+	kn->kn_fop->f_detach(kn);
+	pthread_mutex_unlock(&giant);
+	free(kn);
+}
@@ -0,0 +1,14 @@
+/*
+ * Simulation stub for <machine/cpu.h>.
+ *
+ * Interrupts never arrive in the simulation, so raising the priority level
+ * around run queue changes is a no-op.
+ */
+
+#ifndef _SIM_MACHINE_CPU_H_
+#define _SIM_MACHINE_CPU_H_
+
+#define	splstatclock()	0
+#define	splx(s)		((void)(s))
+
+#endif /* !_SIM_MACHINE_CPU_H_ */
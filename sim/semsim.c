@@ -0,0 +1,1542 @@
+/*
+ * Functional checks and micro-benchmarks for the semaphore system calls,
+ * run against the real cop4600.c inside the simulation harness.
+ *
+ * usage: semsim [-q]	(-q skips the benchmarks)
+ *
+ * Failed checks print a FAIL line and the run ends with "ok" or "FAIL";
+ * benchmarks print one "bench=<name> <key>=<value> ..." line each, in the
+ * format ../sembench.c uses on a real kernel.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "sim.h"
+#include <sys/proc.h>		/* SEM_SCOPE_* */
+#include <sys/param.h>		/* PUSER */
+
+static int failures;
+
+#define CHECK(expr, want) do {						\
+	int got_ = (expr);						\
+	if (got_ != (want)) {						\
+		printf("FAIL %s:%d: %s = %d, want %d\n", __FILE__,	\
+		    __LINE__, #expr, got_, (want));			\
+		failures++;						\
+	}								\
+} while (0)
+
+static double
+now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (ts.tv_sec + ts.tv_nsec / 1e9);
+}
+
+/* --------- FUNCTIONAL CHECKS --------- */
+
+static void
+check_basic(void)
+{
+	struct proc *p = sim_fork(NULL);
+
+	/* Part 1 of kerntest.c */
+	CHECK(sim_allocate_semaphore(p, "Sem1", 0), 0);
+	CHECK(sim_allocate_semaphore(p, "Sem1", 0), EEXIST);
+	CHECK(sim_allocate_semaphore(p,
+	    "abcdefghijklmnopqrstuvwxyz01234567890", 0), ENAMETOOLONG);
+	CHECK(sim_allocate_semaphore(p, "Sem_negative", -1), EDOM);
+	CHECK(sim_up_semaphore(p, "Sem1"), 0);
+	CHECK(sim_up_semaphore(p, "Sem_noexist"), ENOENT);
+	CHECK(sim_free_semaphore(p, "Sem1"), 0);
+	CHECK(sim_free_semaphore(p, "Sem_noexist"), ENOENT);
+	CHECK(sim_free_semaphore(p, "Sem1"), ENOENT);
+	CHECK(sim_up_semaphore(p, "Sem1"), ENOENT);
+	sim_exit(p);
+}
+
+/* The no-op calls of the null-syscall baseline */
+static void
+check_null(void)
+{
+	struct proc *p = sim_fork(NULL);
+	char str[1100];
+	int len;
+
+	CHECK(sim_null(p), 0);
+	CHECK(sim_null_args(p, 1, 2, 3, 4, 5, 6), 0);
+	CHECK(sim_null_str(p, "", &len), 0);
+	CHECK(len, 1);
+	memset(str, 'x', sizeof(str));
+	str[1023] = '\0';
+	CHECK(sim_null_str(p, str, &len), 0);		/* MAX_STR_LENGTH */
+	CHECK(len, 1024);
+	str[1023] = 'x';
+	str[1024] = '\0';
+	CHECK(sim_null_str(p, str, NULL), ENAMETOOLONG);
+	CHECK(sim_null_str(p, NULL, NULL), EFAULT);
+	sim_exit(p);
+}
+
+static void
+check_inheritance(void)
+{
+	struct proc *parent, *c1, *c2, *gc, *ggc;
+
+	parent = sim_fork(NULL);
+	CHECK(sim_allocate_semaphore(parent, "Sem_P", 1), 0);
+	c1 = sim_fork(parent);
+	c2 = sim_fork(parent);
+	CHECK(sim_allocate_semaphore(c1, "Sem_P", 0), 0);	/* shadows */
+	CHECK(sim_allocate_semaphore(c2, "Sem_C2", 0), 0);
+	CHECK(sim_down_semaphore(c1, "Sem_C2"), ENOENT);	/* sibling's */
+	CHECK(sim_down_semaphore(c2, "Sem_P"), 0);		/* inherited */
+	gc = sim_fork(c1);
+	CHECK(sim_up_semaphore(gc, "Sem_P"), 0);		/* c1's */
+	ggc = sim_fork(gc);
+	CHECK(sim_up_semaphore(ggc, "Sem_P"), 0);		/* via gc */
+	CHECK(sim_free_semaphore(c1, "Sem_P"), 0);
+	CHECK(sim_up_semaphore(gc, "Sem_P"), 0);		/* parent's */
+	CHECK(sim_down_semaphore(c2, "Sem_P"), 0);
+	sim_exit(ggc);
+	sim_exit(gc);
+	sim_exit(c1);
+	sim_exit(c2);
+	sim_exit(parent);
+}
+
+struct waiter {
+	struct proc *p;
+	const char *name;
+	int index;		/* slot of a set; 0 goes through plain down */
+	int error;
+};
+
+static void *
+waiter_thread(void *arg)
+{
+	struct waiter *w = arg;
+
+	if (w->index == 0)
+		w->error = sim_down_semaphore(w->p, w->name);
+	else
+		w->error = sim_down_semaphore_index(w->p, w->name, w->index);
+	return (NULL);
+}
+
+/* Waiters on a semaphore that goes away wake up with ENOENT */
+static void
+check_teardown(void)
+{
+	struct proc *parent, *child;
+	struct waiter w;
+	pthread_t t;
+
+	parent = sim_fork(NULL);
+	CHECK(sim_allocate_semaphore(parent, "W", 0), 0);
+	child = sim_fork(parent);
+	w.p = child;
+	w.name = "W";
+	w.index = 0;
+	pthread_create(&t, NULL, waiter_thread, &w);
+	usleep(50000);
+	CHECK(sim_free_semaphore(parent, "W"), 0);
+	pthread_join(t, NULL);
+	CHECK(w.error, ENOENT);
+
+	CHECK(sim_allocate_semaphore(parent, "W", 0), 0);
+	pthread_create(&t, NULL, waiter_thread, &w);
+	usleep(50000);
+	sim_exit(parent);
+	pthread_join(t, NULL);
+	CHECK(w.error, ENOENT);
+	sim_exit(child);
+}
+
+static void
+check_pgrp(void)
+{
+	struct proc *leader, *a, *b, *other;
+	struct waiter w;
+	pthread_t t;
+
+	leader = sim_fork(NULL);
+	sim_setpgrp(leader);
+	a = sim_fork(leader);
+	b = sim_fork(leader);
+	other = sim_fork(NULL);
+	CHECK(sim_allocate_semaphore_scope(a, "grp", 1, SEM_SCOPE_PGRP), 0);
+	CHECK(sim_allocate_semaphore_scope(b, "grp", 1, SEM_SCOPE_PGRP),
+	    EEXIST);
+	CHECK(sim_allocate_semaphore_scope(b, "grp", 1, 42), EINVAL);
+	CHECK(sim_down_semaphore(b, "grp"), 0);		/* sibling's */
+	CHECK(sim_up_semaphore(leader, "grp"), 0);
+	CHECK(sim_up_semaphore(other, "grp"), ENOENT);	/* other group */
+	sim_exit(a);			/* outlives its creator */
+	CHECK(sim_down_semaphore(b, "grp"), 0);
+	sim_exit(b);
+	sim_exit(leader);		/* last member: released */
+
+	/* a group emptied by setpgid() takes its semaphores and sleepers */
+	leader = sim_fork(NULL);
+	sim_setpgrp(leader);
+	a = sim_fork(leader);
+	CHECK(sim_allocate_semaphore_scope(leader, "moved", 0, SEM_SCOPE_PGRP),
+	    0);
+	w.p = a;
+	w.name = "moved";
+	w.index = 0;
+	pthread_create(&t, NULL, waiter_thread, &w);
+	usleep(50000);
+	sim_exit(leader);		/* group lives on in a */
+	CHECK(sim_audit(), 0);
+	sim_setpgrp(a);			/* now empty: released */
+	pthread_join(t, NULL);
+	CHECK(w.error, ENOENT);
+	CHECK(sim_down_semaphore(a, "moved"), ENOENT);
+	CHECK(sim_audit(), 0);
+	sim_exit(a);
+	sim_exit(other);
+}
+
+static void
+check_global(void)
+{
+	struct proc *alice, *bob, *carol, *root;
+
+	alice = sim_fork(NULL);
+	bob = sim_fork(NULL);
+	carol = sim_fork(NULL);
+	root = sim_fork(NULL);
+	sim_setcred(alice, 1000, 100);
+	sim_setcred(bob, 1001, 100);		/* same group as alice */
+	sim_setcred(carol, 1002, 200);
+
+	CHECK(sim_open_semaphore(alice, "/jobs", 0, 0660, 0), ENOENT);
+	CHECK(sim_open_semaphore(alice, "jobs", O_CREAT, 0660, 0), EINVAL);
+	CHECK(sim_allocate_semaphore(alice, "/jobs", 0), EINVAL);
+	CHECK(sim_open_semaphore(alice, "/jobs", O_CREAT, 0660, 1), 0);
+	CHECK(sim_open_semaphore(bob, "/jobs", O_CREAT | O_EXCL, 0660, 1),
+	    EEXIST);
+	CHECK(sim_open_semaphore(bob, "/jobs", O_CREAT, 0660, 1), 0);
+	CHECK(sim_open_semaphore(carol, "/jobs", 0, 0, 0), EACCES);
+	CHECK(sim_down_semaphore(bob, "/jobs"), 0);	/* unrelated process */
+	CHECK(sim_up_semaphore(carol, "/jobs"), EACCES);
+	CHECK(sim_up_semaphore(root, "/jobs"), 0);
+	sim_exit(alice);				/* persists */
+	CHECK(sim_down_semaphore(bob, "/jobs"), 0);
+	CHECK(sim_free_semaphore(bob, "/jobs"), EPERM);
+	CHECK(sim_free_semaphore(root, "/jobs"), 0);
+	CHECK(sim_down_semaphore(bob, "/jobs"), ENOENT);
+	sim_exit(bob);
+	sim_exit(carol);
+	sim_exit(root);
+}
+
+/* Sets: one name, independent slots, slot 0 doubling as the plain semaphore */
+static void
+check_set(void)
+{
+	struct proc *parent, *child;
+	struct waiter w;
+	pthread_t t;
+
+	parent = sim_fork(NULL);
+	CHECK(sim_allocate_semaphore_set(parent, "bank", 0, 1), EINVAL);
+	CHECK(sim_allocate_semaphore_set(parent, "bank", SEM_NSEMS_MAX + 1, 1),
+	    EINVAL);
+	CHECK(sim_allocate_semaphore_set(parent, "bank", 64, -1), EDOM);
+	CHECK(sim_allocate_semaphore_set(parent, "bank", 64, 1), 0);
+	CHECK(sim_allocate_semaphore(parent, "bank", 0), EEXIST);
+	CHECK(sim_down_semaphore_index(parent, "bank", 64), EINVAL);
+	CHECK(sim_up_semaphore_index(parent, "bank", -1), EINVAL);
+	CHECK(sim_down_semaphore_index(parent, "nobank", 0), ENOENT);
+	CHECK(sim_down_semaphore_index(parent, "bank", 63), 0);
+	CHECK(sim_down_semaphore_index(parent, "bank", 5), 0);
+	CHECK(sim_down_semaphore(parent, "bank"), 0);		/* slot 0 */
+	CHECK(sim_down_semaphore_index(parent, "bank", 1), 0);
+	CHECK(sim_allocate_semaphore(parent, "plain", 0), 0);
+	CHECK(sim_up_semaphore_index(parent, "plain", 0), 0);
+	CHECK(sim_down_semaphore_index(parent, "plain", 1), EINVAL);
+	CHECK(sim_audit(), 0);
+
+	/* a waiter on one slot is posted by that slot only */
+	child = sim_fork(parent);
+	w.p = child;
+	w.name = "bank";
+	w.index = 63;
+	pthread_create(&t, NULL, waiter_thread, &w);
+	usleep(50000);
+	CHECK(sim_up_semaphore_index(parent, "bank", 62), 0);
+	CHECK(sim_up_semaphore_index(parent, "bank", 63), 0);
+	pthread_join(t, NULL);
+	CHECK(w.error, 0);
+
+	/* and woken with ENOENT when the whole set goes */
+	pthread_create(&t, NULL, waiter_thread, &w);
+	usleep(50000);
+	CHECK(sim_free_semaphore(parent, "bank"), 0);
+	pthread_join(t, NULL);
+	CHECK(w.error, ENOENT);
+	CHECK(sim_up_semaphore_index(child, "bank", 0), ENOENT);
+	sim_exit(child);
+	sim_exit(parent);
+}
+
+struct arriver {
+	struct proc *p;
+	int phases;
+	int error;
+	int phase[3];
+};
+
+static void *
+arriver_thread(void *arg)
+{
+	struct arriver *a = arg;
+	int i;
+
+	for (i = 0; i < a->phases && a->error == 0; i++)
+		a->error = sim_wait_barrier(a->p, "B", &a->phase[i]);
+	return (NULL);
+}
+
+/* Barriers: every arrival of a phase leaves together with its number */
+static void
+check_barrier(void)
+{
+	struct proc *parent;
+	struct arriver a[4];
+	pthread_t t[4];
+	int i, j;
+
+	parent = sim_fork(NULL);
+	CHECK(sim_allocate_barrier(parent, "B", 0), EINVAL);
+	CHECK(sim_allocate_barrier(parent, "B", 4), 0);
+	CHECK(sim_allocate_barrier(parent, "B", 4), EEXIST);
+	CHECK(sim_down_semaphore(parent, "B"), EINVAL);
+	CHECK(sim_up_semaphore_index(parent, "B", 0), EINVAL);
+	CHECK(sim_allocate_semaphore(parent, "S", 0), 0);
+	CHECK(sim_wait_barrier(parent, "S", NULL), EINVAL);
+	CHECK(sim_wait_barrier(parent, "nobarrier", NULL), ENOENT);
+
+	for (i = 0; i < 4; i++) {
+		a[i].p = i == 0 ? parent : sim_fork(parent);
+		a[i].phases = 3;
+		a[i].error = 0;
+		pthread_create(&t[i], NULL, arriver_thread, &a[i]);
+	}
+	for (i = 0; i < 4; i++) {
+		pthread_join(t[i], NULL);
+		CHECK(a[i].error, 0);
+		for (j = 0; j < 3; j++)
+			CHECK(a[i].phase[j], j);
+	}
+	CHECK(sim_audit(), 0);
+
+	/* a short phase never completes; its arrivals see the barrier go */
+	for (i = 1; i < 3; i++) {
+		a[i].phases = 1;
+		pthread_create(&t[i], NULL, arriver_thread, &a[i]);
+	}
+	usleep(50000);
+	CHECK(sim_audit(), 0);
+	CHECK(sim_free_semaphore(parent, "B"), 0);
+	for (i = 1; i < 3; i++) {
+		pthread_join(t[i], NULL);
+		CHECK(a[i].error, ENOENT);
+	}
+	for (i = 1; i < 4; i++)
+		sim_exit(a[i].p);
+	sim_exit(parent);
+}
+
+/* kevent: a note fires when its slot becomes downable, and at teardown */
+static void
+check_kevent(void)
+{
+	struct proc *parent, *child;
+	struct knote *kn, *kn5;
+	struct waiter w;
+	pthread_t t;
+	long data;
+	int error, eof;
+
+	parent = sim_fork(NULL);
+	CHECK(sim_allocate_semaphore(parent, "K", 0), 0);
+	CHECK(sim_allocate_semaphore_set(parent, "KS", 8, 0), 0);
+	CHECK(sim_allocate_barrier(parent, "KB", 2), 0);
+	CHECK(sim_kevent_attach(parent, "nosem", 0, &error) == NULL, 1);
+	CHECK(error, ENOENT);
+	CHECK(sim_kevent_attach(parent, "KB", 0, &error) == NULL, 1);
+	CHECK(error, EINVAL);
+	CHECK(sim_kevent_attach(parent, "KS", 8, &error) == NULL, 1);
+	CHECK(error, EINVAL);
+
+	child = sim_fork(parent);
+	kn = sim_kevent_attach(child, "K", 0, &error);
+	kn5 = sim_kevent_attach(child, "KS", 5, &error);
+	CHECK(error, 0);
+	CHECK(sim_kevent_scan(kn, NULL, NULL), 0);
+	CHECK(sim_up_semaphore(parent, "K"), 0);
+	CHECK(sim_kevent_scan(kn, &data, &eof), 1);
+	CHECK(data, 1);
+	CHECK(eof, 0);
+	CHECK(sim_kevent_scan(kn, NULL, NULL), 0);	/* cleared */
+
+	/* fired, then drained before the scan: nothing to report */
+	CHECK(sim_up_semaphore(parent, "K"), 0);
+	CHECK(sim_down_semaphore(child, "K"), 0);
+	CHECK(sim_down_semaphore(child, "K"), 0);
+	CHECK(sim_kevent_scan(kn, NULL, NULL), 0);
+
+	/* an up that goes to a sleeper does not make the slot downable */
+	w.p = child;
+	w.name = "K";
+	w.index = 0;
+	pthread_create(&t, NULL, waiter_thread, &w);
+	usleep(50000);
+	CHECK(sim_up_semaphore(parent, "K"), 0);
+	pthread_join(t, NULL);
+	CHECK(w.error, 0);
+	CHECK(sim_kevent_scan(kn, NULL, NULL), 0);
+
+	/* set notes watch their own slot only */
+	CHECK(sim_up_semaphore_index(parent, "KS", 4), 0);
+	CHECK(sim_kevent_scan(kn5, NULL, NULL), 0);
+	CHECK(sim_up_semaphore_index(parent, "KS", 5), 0);
+	CHECK(sim_kevent_scan(kn5, &data, NULL), 1);
+	CHECK(data, 1);
+
+	CHECK(sim_free_semaphore(parent, "K"), 0);
+	CHECK(sim_kevent_scan(kn, &data, &eof), 1);
+	CHECK(eof, 1);
+	sim_kevent_detach(kn);
+	sim_kevent_detach(kn5);		/* still attached */
+	sim_exit(child);
+	sim_exit(parent);
+}
+
+struct anywaiter {
+	struct proc *p;
+	const char **names;
+	int n, which, error;
+};
+
+static void *
+anywaiter_thread(void *arg)
+{
+	struct anywaiter *w = arg;
+
+	w->error = sim_down_semaphore_any(w->p, w->names, w->n, &w->which);
+	return (NULL);
+}
+
+/* Wait-for-any: exactly one semaphore taken, the other queues left clean */
+static void
+check_any(void)
+{
+	static const char *abc[] = { "A", "B", "C" };
+	static const char *aa[] = { "A", "A" };
+	static const char *bad[] = { "A", "nosem" };
+	static const char *barrier[] = { "A", "AB" };
+	struct proc *parent, *child;
+	struct anywaiter w;
+	pthread_t t;
+	int which;
+
+	parent = sim_fork(NULL);
+	CHECK(sim_allocate_semaphore(parent, "A", 0), 0);
+	CHECK(sim_allocate_semaphore(parent, "B", 0), 0);
+	CHECK(sim_allocate_semaphore(parent, "C", 0), 0);
+	CHECK(sim_allocate_barrier(parent, "AB", 2), 0);
+	CHECK(sim_down_semaphore_any(parent, abc, 0, NULL), EINVAL);
+	CHECK(sim_down_semaphore_any(parent, abc, SEM_ANY_MAX + 1, NULL),
+	    EINVAL);
+	CHECK(sim_down_semaphore_any(parent, bad, 2, NULL), ENOENT);
+	CHECK(sim_down_semaphore_any(parent, barrier, 2, NULL), EINVAL);
+
+	/* free one is taken without sleeping */
+	CHECK(sim_up_semaphore(parent, "C"), 0);
+	CHECK(sim_down_semaphore_any(parent, abc, 3, &which), 0);
+	CHECK(which, 2);
+
+	child = sim_fork(parent);
+	w.p = child;
+	w.names = abc;
+	w.n = 3;
+	pthread_create(&t, NULL, anywaiter_thread, &w);
+	usleep(50000);
+	CHECK(sim_audit(), 0);
+	CHECK(sim_up_semaphore(parent, "B"), 0);
+	pthread_join(t, NULL);
+	CHECK(w.error, 0);
+	CHECK(w.which, 1);
+	CHECK(sim_audit(), 0);
+	/* A and C were given back: an up on each is there to take */
+	CHECK(sim_up_semaphore(parent, "A"), 0);
+	CHECK(sim_up_semaphore(parent, "C"), 0);
+	CHECK(sim_down_semaphore_any(parent, abc, 3, &which), 0);
+	CHECK(which, 0);
+	CHECK(sim_down_semaphore_any(parent, abc, 3, &which), 0);
+	CHECK(which, 2);
+
+	/* queued behind a plain waiter: unlinked from the tail of A's queue */
+	{
+		struct waiter pw;
+		pthread_t pt;
+
+		pw.p = parent;
+		pw.name = "A";
+		pw.index = 0;
+		pthread_create(&pt, NULL, waiter_thread, &pw);
+		usleep(50000);
+		w.names = abc;
+		w.n = 2;
+		pthread_create(&t, NULL, anywaiter_thread, &w);
+		usleep(50000);
+		CHECK(sim_up_semaphore(parent, "B"), 0);
+		pthread_join(t, NULL);
+		CHECK(w.which, 1);
+		CHECK(sim_audit(), 0);
+		CHECK(sim_up_semaphore(parent, "A"), 0);
+		pthread_join(pt, NULL);
+		CHECK(pw.error, 0);
+	}
+
+	/* the same name twice */
+	w.names = aa;
+	w.n = 2;
+	pthread_create(&t, NULL, anywaiter_thread, &w);
+	usleep(50000);
+	CHECK(sim_up_semaphore(parent, "A"), 0);
+	pthread_join(t, NULL);
+	CHECK(w.error, 0);
+	CHECK(w.which, 0);
+	CHECK(sim_audit(), 0);
+
+	/* freeing one ends the wait with ENOENT and releases the others */
+	w.names = abc;
+	w.n = 3;
+	pthread_create(&t, NULL, anywaiter_thread, &w);
+	usleep(50000);
+	CHECK(sim_free_semaphore(parent, "B"), 0);
+	pthread_join(t, NULL);
+	CHECK(w.error, ENOENT);
+	CHECK(w.which, 1);
+	CHECK(sim_audit(), 0);
+	CHECK(sim_up_semaphore(parent, "A"), 0);
+	CHECK(sim_down_semaphore(parent, "A"), 0);
+	sim_exit(child);
+	sim_exit(parent);
+}
+
+/*
+ * SEM_BARGE: sleepers are not charged and an up() only wakes one to compete,
+ * so whether the poster or the sleeper gets the unit is up to the scheduler.
+ * Every interleaving must leave the counts balanced.
+ */
+struct contender {
+	struct proc *p;
+	const char *name;
+	int rounds;
+	int hold;		/* ns spent holding the unit */
+	double *lat;		/* per-acquire latency, or NULL */
+};
+
+static void *
+contender_thread(void *arg)
+{
+	struct contender *c = arg;
+	double t;
+	int i;
+
+	for (i = 0; i < c->rounds; i++) {
+		t = now();
+		if (sim_down_semaphore(c->p, c->name) != 0)
+			break;
+		if (c->lat != NULL)
+			c->lat[i] = now() - t;
+		for (t = now() + c->hold / 1e9; now() < t; )
+			;
+		sim_up_semaphore(c->p, c->name);
+	}
+	return (NULL);
+}
+
+static void
+check_barge(void)
+{
+	struct proc *parent, *child[4];
+	struct contender c[4];
+	struct waiter w;
+	struct knote *kn;
+	pthread_t t[4];
+	long data;
+	int error, eof, i;
+
+	parent = sim_fork(NULL);
+	CHECK(sim_allocate_semaphore_flags(parent, "G", 0, ~SEM_FLAGS), EINVAL);
+	CHECK(sim_allocate_semaphore_flags(parent, "G", -1, SEM_BARGE), EDOM);
+	CHECK(sim_allocate_semaphore_flags(parent, "G", 0, SEM_BARGE), 0);
+	CHECK(sim_allocate_semaphore_flags(parent, "G", 0, 0), EEXIST);
+	CHECK(sim_up_semaphore(parent, "G"), 0);
+	CHECK(sim_down_semaphore(parent, "G"), 0);
+
+	/* an up() with a sleeper leaves the unit up for grabs */
+	child[0] = sim_fork(parent);
+	w.p = child[0];
+	w.name = "G";
+	w.index = 0;
+	pthread_create(&t[0], NULL, waiter_thread, &w);
+	usleep(50000);
+	CHECK(sim_audit(), 0);
+	CHECK(sim_up_semaphore(parent, "G"), 0);
+	CHECK(sim_audit(), 0);
+	pthread_join(t[0], NULL);
+	CHECK(w.error, 0);
+	CHECK(sim_audit(), 0);
+
+	/* freed while a woken sleeper is still queued to retry */
+	pthread_create(&t[0], NULL, waiter_thread, &w);
+	usleep(50000);
+	CHECK(sim_up_semaphore(parent, "G"), 0);
+	CHECK(sim_free_semaphore(parent, "G"), 0);
+	pthread_join(t[0], NULL);
+	CHECK(w.error == 0 || w.error == ENOENT, 1);
+
+	/* contention: every down() is matched, so the unit ends up free */
+	CHECK(sim_allocate_semaphore_flags(parent, "G", 1, SEM_BARGE), 0);
+	for (i = 0; i < 4; i++) {
+		if (i > 0)
+			child[i] = sim_fork(parent);
+		c[i].p = child[i];
+		c[i].name = "G";
+		c[i].rounds = 5000;
+		c[i].hold = 0;
+		c[i].lat = NULL;
+		pthread_create(&t[i], NULL, contender_thread, &c[i]);
+	}
+	for (i = 0; i < 200; i++) {
+		CHECK(sim_audit(), 0);
+		usleep(500);
+	}
+	for (i = 0; i < 4; i++)
+		pthread_join(t[i], NULL);
+	CHECK(sim_audit(), 0);
+	kn = sim_kevent_attach(parent, "G", 0, &error);
+	CHECK(error, 0);
+	CHECK(sim_up_semaphore(parent, "G"), 0);
+	CHECK(sim_kevent_scan(kn, &data, &eof), 1);
+	CHECK(data, 2);
+	sim_kevent_detach(kn);
+	for (i = 0; i < 4; i++)
+		sim_exit(child[i]);
+	sim_exit(parent);
+}
+
+/*
+ * SEM_MUTEX: only the holder may up it, and while someone better waits the
+ * holder runs at the waiter's priority.
+ */
+static void
+check_mutex(void)
+{
+	static const char *any[] = { "M" };
+	struct proc *parent, *low, *high;
+	struct waiter w, w2;
+	pthread_t t, t2;
+
+	parent = sim_fork(NULL);
+	CHECK(sim_allocate_semaphore_flags(parent, "M", 2, SEM_MUTEX), EINVAL);
+	CHECK(sim_allocate_semaphore_flags(parent, "M", 1, SEM_MUTEX), 0);
+	CHECK(sim_down_semaphore_any(parent, any, 1, NULL), EINVAL);
+	low = sim_fork(parent);
+	high = sim_fork(parent);
+	sim_setnice(low, 10);
+	CHECK(sim_priority(low), PUSER + 20);
+	CHECK(sim_priority(high), PUSER);
+
+	CHECK(sim_down_semaphore(low, "M"), 0);
+	CHECK(sim_down_semaphore(low, "M"), EDEADLK);
+	CHECK(sim_up_semaphore(parent, "M"), EPERM);
+	CHECK(sim_up_semaphore_index(parent, "M", 0), EPERM);
+	CHECK(sim_audit(), 0);
+
+	/* high waits: low is lent its priority until it unlocks */
+	w.p = high;
+	w.name = "M";
+	w.index = 0;
+	pthread_create(&t, NULL, waiter_thread, &w);
+	usleep(50000);
+	CHECK(sim_priority(low), PUSER);
+	CHECK(sim_audit(), 0);
+	CHECK(sim_up_semaphore(low, "M"), 0);
+	pthread_join(t, NULL);
+	CHECK(w.error, 0);
+	CHECK(sim_priority(low), PUSER + 20);
+	CHECK(sim_up_semaphore(low, "M"), EPERM);	/* high holds it now */
+	CHECK(sim_audit(), 0);
+
+	/* a holder that exits unlocks, handing over to the next in line */
+	w2.p = low;
+	w2.name = "M";
+	w2.index = 0;
+	pthread_create(&t2, NULL, waiter_thread, &w2);
+	usleep(50000);
+	sim_exit(high);
+	pthread_join(t2, NULL);
+	CHECK(w2.error, 0);
+	CHECK(sim_audit(), 0);
+	CHECK(sim_up_semaphore_index(low, "M", 0), 0);
+
+	/* unlocked, nobody may up it: the count stays at one */
+	CHECK(sim_up_semaphore(low, "M"), EPERM);
+	CHECK(sim_up_semaphore_index(parent, "M", 0), EPERM);
+	CHECK(sim_down_semaphore_index(low, "M", 0), 0);
+	CHECK(sim_down_semaphore(low, "M"), EDEADLK);
+	CHECK(sim_audit(), 0);
+	CHECK(sim_up_semaphore(low, "M"), 0);
+
+	/* created locked by its creator; freed while held */
+	CHECK(sim_allocate_semaphore_flags(parent, "M2", 0,
+	    SEM_MUTEX | SEM_BARGE), 0);
+	CHECK(sim_up_semaphore(low, "M2"), EPERM);
+	w.p = low;
+	w.name = "M2";
+	pthread_create(&t, NULL, waiter_thread, &w);
+	usleep(50000);
+	CHECK(sim_priority(parent), PUSER);
+	CHECK(sim_audit(), 0);
+	CHECK(sim_free_semaphore(parent, "M2"), 0);
+	pthread_join(t, NULL);
+	CHECK(w.error, ENOENT);
+	sim_exit(low);
+	sim_exit(parent);
+}
+
+struct courier {
+	struct proc *p;
+	const char *name;
+	const char *msgs;	/* send: packed messages */
+	const int *lens;
+	int n;
+	int error, done;
+};
+
+static void *
+sender_thread(void *arg)
+{
+	struct courier *c = arg;
+
+	if (c->n == 1)
+		c->error = sim_channel_send(c->p, c->name, c->msgs, c->lens[0]);
+	else
+		c->error = sim_channel_send_batch(c->p, c->name, c->msgs,
+		    c->lens, c->n, &c->done);
+	return (NULL);
+}
+
+static void *
+receiver_thread(void *arg)
+{
+	struct courier *c = arg;
+	char buf[SEM_MSG_MAX];
+
+	c->error = sim_channel_receive(c->p, c->name, buf, sizeof(buf),
+	    &c->done);
+	return (NULL);
+}
+
+/* Channels: bounded, FIFO, and blocking at both ends */
+static void
+check_channel(void)
+{
+	static const int one[] = { 1 };
+	static const int six[] = { 1, 2, 3, 4, 5, 6 };
+	struct proc *parent, *child;
+	struct courier c;
+	struct knote *kn;
+	pthread_t t;
+	char buf[SEM_MSG_MAX * 2], msg[16];
+	int lens[SEM_BATCH_MAX];
+	int error, eof, got, i, len, n;
+	long data;
+
+	parent = sim_fork(NULL);
+	CHECK(sim_allocate_channel(parent, "ch", 0, 16), EINVAL);
+	CHECK(sim_allocate_channel(parent, "ch", SEM_CHAN_MAX + 1, 16), EINVAL);
+	CHECK(sim_allocate_channel(parent, "ch", 4, SEM_MSG_MAX + 1), EINVAL);
+	CHECK(sim_allocate_channel(parent, "ch", 4, 16), 0);
+	CHECK(sim_allocate_semaphore(parent, "ch", 0), EEXIST);
+	CHECK(sim_allocate_semaphore(parent, "S", 0), 0);
+	CHECK(sim_down_semaphore(parent, "ch"), EINVAL);
+	CHECK(sim_channel_send(parent, "S", "x", 1), EINVAL);
+	CHECK(sim_channel_send(parent, "nochan", "x", 1), ENOENT);
+	CHECK(sim_channel_send(parent, "ch", buf, 17), EMSGSIZE);
+	CHECK(sim_channel_receive(parent, "ch", buf, 15, NULL), EMSGSIZE);
+
+	CHECK(sim_channel_send(parent, "ch", "hello", 5), 0);
+	CHECK(sim_channel_send(parent, "ch", "", 0), 0);
+	CHECK(sim_channel_receive(parent, "ch", buf, sizeof(buf), &got), 0);
+	CHECK(got, 5);
+	CHECK(memcmp(buf, "hello", 5), 0);
+	CHECK(sim_channel_receive(parent, "ch", buf, sizeof(buf), &got), 0);
+	CHECK(got, 0);
+	CHECK(sim_audit(), 0);
+
+	/* a full channel holds the sender until a receive makes room */
+	for (i = 0; i < 4; i++) {
+		msg[0] = 'a' + i;
+		CHECK(sim_channel_send(parent, "ch", msg, 1), 0);
+	}
+	child = sim_fork(parent);
+	c.p = child;
+	c.name = "ch";
+	c.msgs = "e";
+	c.lens = one;
+	c.n = 1;
+	pthread_create(&t, NULL, sender_thread, &c);
+	usleep(50000);
+	CHECK(sim_audit(), 0);
+	for (i = 0; i < 5; i++) {
+		CHECK(sim_channel_receive(parent, "ch", buf, sizeof(buf),
+		    &got), 0);
+		CHECK(buf[0], 'a' + i);
+		if (i == 0)
+			pthread_join(t, NULL);
+	}
+	CHECK(c.error, 0);
+
+	/* an empty one holds the receiver until a send */
+	pthread_create(&t, NULL, receiver_thread, &c);
+	usleep(50000);
+	CHECK(sim_audit(), 0);
+	CHECK(sim_channel_send(parent, "ch", "late", 4), 0);
+	pthread_join(t, NULL);
+	CHECK(c.error, 0);
+	CHECK(c.done, 4);
+
+	/* a batch larger than the channel goes through in pieces, in order */
+	c.msgs = "abbcccddddeeeeeffffff";
+	c.lens = six;
+	c.n = 6;
+	pthread_create(&t, NULL, sender_thread, &c);
+	usleep(50000);
+	CHECK(sim_audit(), 0);
+	for (i = 0, n = 0; n < 6; n += got) {
+		CHECK(sim_channel_receive_batch(parent, "ch", buf, 32, lens,
+		    SEM_BATCH_MAX, &got), 0);
+		CHECK(got >= 1, 1);
+		for (i = 0, len = 0; i < got; i++) {
+			CHECK(lens[i], n + i + 1);
+			len += lens[i];
+		}
+		/* room is checked per record */
+		CHECK(len - lens[got - 1] + 16 <= 32, 1);
+	}
+	pthread_join(t, NULL);
+	CHECK(c.error, 0);
+	CHECK(c.done, 6);
+	CHECK(sim_channel_receive_batch(parent, "ch", buf, 8, lens, 1, NULL),
+	    EMSGSIZE);
+	CHECK(sim_channel_send_batch(parent, "ch", buf, lens, 0, NULL), EINVAL);
+
+	/* kevent: readable once a message is queued */
+	kn = sim_kevent_attach(parent, "ch", SEM_CHAN_ITEMS, &error);
+	CHECK(error, 0);
+	CHECK(sim_channel_send(parent, "ch", "k", 1), 0);
+	CHECK(sim_kevent_scan(kn, &data, &eof), 1);
+	CHECK(data, 1);
+	sim_kevent_detach(kn);
+
+	/*
+	 * freed between posting a sleeping sender and the sender running:
+	 * fill it, park a sender, then receive and free in one go
+	 */
+	CHECK(sim_channel_receive(parent, "ch", buf, sizeof(buf), NULL), 0);
+	for (i = 0; i < 4; i++)
+		CHECK(sim_channel_send(parent, "ch", "f", 1), 0);
+	c.msgs = "g";
+	c.lens = one;
+	c.n = 1;
+	pthread_create(&t, NULL, sender_thread, &c);
+	usleep(50000);
+	sim_enter();
+	CHECK(sim_channel_receive(parent, "ch", buf, sizeof(buf), NULL), 0);
+	CHECK(sim_free_semaphore(parent, "ch"), 0);
+	sim_leave();
+	pthread_join(t, NULL);
+	CHECK(c.error, ENOENT);
+	CHECK(sim_allocate_channel(parent, "ch", 4, 16), 0);
+
+	/* freed under a sleeping receiver */
+	pthread_create(&t, NULL, receiver_thread, &c);
+	usleep(50000);
+	CHECK(sim_free_semaphore(parent, "ch"), 0);
+	pthread_join(t, NULL);
+	CHECK(c.error, ENOENT);
+
+	/* a bad buffer is refused before anything is dequeued */
+	CHECK(sim_allocate_channel(parent, "ch", 4, 16), 0);
+	CHECK(sim_channel_send(parent, "ch", "q", 1), 0);
+	CHECK(sim_channel_receive(parent, "ch", NULL, 16, NULL), EFAULT);
+	CHECK(sim_channel_receive_batch(parent, "ch", NULL, 32, lens, 2, NULL),
+	    EFAULT);
+	CHECK(sim_channel_receive_batch(parent, "ch", buf, 32, NULL, 2, NULL),
+	    EFAULT);
+	CHECK(sim_channel_receive(parent, "ch", buf, sizeof(buf), &got), 0);
+	CHECK(got, 1);
+	CHECK(buf[0], 'q');
+
+	/* freed part way through a batch: the messages sent are reported */
+	c.msgs = "abbcccddddeeeeeffffff";
+	c.lens = six;
+	c.n = 6;
+	pthread_create(&t, NULL, sender_thread, &c);
+	usleep(50000);		/* four sent, asleep for room */
+	CHECK(sim_free_semaphore(parent, "ch"), 0);
+	pthread_join(t, NULL);
+	CHECK(c.error, 0);
+	CHECK(c.done, 4);
+	CHECK(sim_channel_send_batch(parent, "ch", "ab", six, 2, NULL), ENOENT);
+	sim_exit(child);
+	sim_exit(parent);
+}
+
+struct cvwaiter {
+	struct proc *p;
+	const char *mutex;
+	volatile int *ready;
+	int error, upped;
+};
+
+/* down(mutex); while (!ready) wait(cv, mutex); up(mutex) */
+static void *
+cvwaiter_thread(void *arg)
+{
+	struct cvwaiter *w = arg;
+
+	if ((w->error = sim_down_semaphore(w->p, w->mutex)) != 0)
+		return (NULL);
+	while (!*w->ready && w->error == 0)
+		w->error = sim_wait_condition(w->p, "cv", w->mutex);
+	w->upped = sim_up_semaphore(w->p, w->mutex);
+	return (NULL);
+}
+
+/* Condition variables over a plain and a SEM_MUTEX semaphore */
+static void
+check_condition(void)
+{
+	struct proc *parent, *child[2];
+	struct cvwaiter w[2];
+	pthread_t t[2];
+	volatile int ready = 0;
+	int i, woken;
+
+	parent = sim_fork(NULL);
+	CHECK(sim_allocate_condition(parent, "cv"), 0);
+	CHECK(sim_allocate_condition(parent, "cv"), EEXIST);
+	CHECK(sim_allocate_semaphore(parent, "m", 1), 0);
+	CHECK(sim_allocate_semaphore_flags(parent, "pm", 1, SEM_MUTEX), 0);
+	CHECK(sim_wait_condition(parent, "cv", "m"), EPERM);	/* not held */
+	CHECK(sim_wait_condition(parent, "cv", "nomutex"), ENOENT);
+	CHECK(sim_wait_condition(parent, "m", "m"), EINVAL);
+	CHECK(sim_down_semaphore(parent, "cv"), EINVAL);
+	CHECK(sim_signal_condition(parent, "cv", &woken), 0);
+	CHECK(woken, 0);			/* lost, not banked */
+
+	/* broadcast wakes both; each gets the mutex back in turn */
+	for (i = 0; i < 2; i++) {
+		child[i] = sim_fork(parent);
+		w[i].p = child[i];
+		w[i].mutex = "m";
+		w[i].ready = &ready;
+		pthread_create(&t[i], NULL, cvwaiter_thread, &w[i]);
+	}
+	usleep(50000);
+	CHECK(sim_audit(), 0);
+	CHECK(sim_down_semaphore(parent, "m"), 0);	/* both let it go */
+	ready = 1;
+	CHECK(sim_broadcast_condition(parent, "cv", &woken), 0);
+	CHECK(woken, 2);
+	CHECK(sim_up_semaphore(parent, "m"), 0);
+	for (i = 0; i < 2; i++) {
+		pthread_join(t[i], NULL);
+		CHECK(w[i].error, 0);
+		CHECK(w[i].upped, 0);
+	}
+	CHECK(sim_audit(), 0);
+
+	/* signal wakes one; a SEM_MUTEX comes back owned by the waiter */
+	ready = 0;
+	CHECK(sim_wait_condition(child[1], "cv", "pm"), EPERM);
+	for (i = 0; i < 2; i++) {
+		w[i].mutex = "pm";
+		pthread_create(&t[i], NULL, cvwaiter_thread, &w[i]);
+	}
+	usleep(50000);
+	ready = 1;
+	CHECK(sim_signal_condition(parent, "cv", &woken), 0);
+	CHECK(woken, 1);
+	usleep(50000);
+	CHECK(sim_signal_condition(parent, "cv", &woken), 0);
+	CHECK(woken, 1);
+	for (i = 0; i < 2; i++) {
+		pthread_join(t[i], NULL);
+		CHECK(w[i].error, 0);
+		CHECK(w[i].upped, 0);
+	}
+
+	/* freeing the condition ends the wait, still relocking the mutex */
+	ready = 0;
+	w[0].mutex = "m";
+	pthread_create(&t[0], NULL, cvwaiter_thread, &w[0]);
+	usleep(50000);
+	CHECK(sim_free_semaphore(parent, "cv"), 0);
+	pthread_join(t[0], NULL);
+	CHECK(w[0].error, ENOENT);
+	CHECK(w[0].upped, 0);
+	CHECK(sim_audit(), 0);
+	for (i = 0; i < 2; i++)
+		sim_exit(child[i]);
+	sim_exit(parent);
+}
+
+/* --------- BENCHMARKS --------- */
+
+/* Same line format as ../sembench.c */
+static void
+report(const char *bench, const char *params, int ops, double secs)
+{
+	printf("bench=%s %siters=%d ns_per_op=%.1f ops_per_sec=%.0f\n", bench,
+	    params, ops, secs * 1e9 / ops, ops / secs);
+}
+
+static void
+fill(struct proc *p, int owned)
+{
+	char name[32];
+	int i;
+
+	for (i = 0; i < owned; i++) {
+		snprintf(name, sizeof(name), "pad%d", i);
+		sim_allocate_semaphore(p, name, 0);
+	}
+}
+
+/*
+ * up() on a semaphore `depth' ancestors up, `owned' fillers per level.
+ */
+static void
+bench_lookup(int depth, int owned)
+{
+	struct proc *procs[depth + 1];
+	const int iters = 200000;
+	char params[64];
+	double t;
+	int i;
+
+	procs[0] = sim_fork(NULL);
+	sim_allocate_semaphore(procs[0], "root", 0);
+	fill(procs[0], owned);
+	for (i = 1; i <= depth; i++) {
+		procs[i] = sim_fork(procs[i - 1]);
+		fill(procs[i], owned);
+	}
+	t = now();
+	for (i = 0; i < iters; i++)
+		sim_up_semaphore(procs[depth], "root");
+	t = now() - t;
+	snprintf(params, sizeof(params), "depth=%d owned=%d ", depth, owned);
+	report("lookup", params, iters, t);
+	for (i = depth; i >= 0; i--)
+		sim_exit(procs[i]);
+}
+
+/*
+ * A bank of `nsems' semaphores as separate names slot0..slotN-1 against one
+ * set: allocate the bank, up() its last member once, tear it down.
+ */
+static void
+bench_bank(int nsems, int set)
+{
+	const int iters = 2000;
+	char name[32], params[64];
+	struct proc *p;
+	double t;
+	int i, j;
+
+	t = now();
+	for (i = 0; i < iters; i++) {
+		p = sim_fork(NULL);
+		if (set) {
+			sim_allocate_semaphore_set(p, "slot", nsems, 0);
+			sim_up_semaphore_index(p, "slot", nsems - 1);
+		} else {
+			for (j = 0; j < nsems; j++) {
+				snprintf(name, sizeof(name), "slot%d", j);
+				sim_allocate_semaphore(p, name, 0);
+			}
+			sim_up_semaphore(p, name);
+		}
+		sim_exit(p);
+	}
+	t = now() - t;
+	snprintf(params, sizeof(params), "nsems=%d set=%d ", nsems, set);
+	report("bank", params, iters, t);
+}
+
+struct phaser {
+	struct proc *p;
+	int id, phases, native;
+};
+
+static void *
+phaser_thread(void *arg)
+{
+	struct phaser *ph = arg;
+	int i;
+
+	for (i = 0; i < ph->phases; i++)
+		if (ph->native)
+			sim_wait_barrier(ph->p, "B", NULL);
+		else {
+			sim_up_semaphore(ph->p, "arrive");
+			sim_down_semaphore_index(ph->p, "depart", ph->id);
+		}
+	return (NULL);
+}
+
+/*
+ * `n' processes through a run of phases, on a barrier against the same
+ * barrier built from semaphores: an arrival counter drained by a
+ * coordinator that then posts one depart slot per process.
+ */
+static void
+bench_barrier(int n, int native)
+{
+	struct proc *parent;
+	struct phaser ph[n];
+	pthread_t t[n];
+	const int phases = 5000;
+	char params[64];
+	double start;
+	int i, j;
+
+	parent = sim_fork(NULL);
+	sim_allocate_barrier(parent, "B", n);
+	sim_allocate_semaphore(parent, "arrive", 0);
+	sim_allocate_semaphore_set(parent, "depart", n, 0);
+	start = now();
+	for (i = 0; i < n; i++) {
+		ph[i].p = sim_fork(parent);
+		ph[i].id = i;
+		ph[i].phases = phases;
+		ph[i].native = native;
+		pthread_create(&t[i], NULL, phaser_thread, &ph[i]);
+	}
+	if (!native)
+		for (i = 0; i < phases; i++) {
+			for (j = 0; j < n; j++)
+				sim_down_semaphore(parent, "arrive");
+			for (j = 0; j < n; j++)
+				sim_up_semaphore_index(parent, "depart", j);
+		}
+	for (i = 0; i < n; i++)
+		pthread_join(t[i], NULL);
+	start = now() - start;
+	snprintf(params, sizeof(params), "procs=%d native=%d ", n, native);
+	report("barrier", params, phases, start);
+	for (i = 0; i < n; i++)
+		sim_exit(ph[i].p);
+	sim_exit(parent);
+}
+
+/*
+ * up() then down() on semaphores picked at random from `nsems' owned by
+ * one process.  Each lookup walks the owner's list, so with enough of
+ * them the cost is dominated by the cache lines each semaphore_t drags in.
+ */
+static void
+bench_spread(int nsems)
+{
+	struct proc *p = sim_fork(NULL);
+	const int iters = 200000 / (nsems / 64 + 1);
+	char (*names)[32], params[64];
+	unsigned int seed = 1;
+	double t;
+	int i, j;
+
+	if ((names = malloc(nsems * sizeof(*names))) == NULL) {
+		perror("malloc");
+		exit(1);
+	}
+	for (i = 0; i < nsems; i++) {
+		snprintf(names[i], sizeof(names[i]), "spread%d", i);
+		sim_allocate_semaphore(p, names[i], 0);
+	}
+	t = now();
+	for (i = 0; i < iters; i++) {
+		j = rand_r(&seed) % nsems;
+		sim_up_semaphore(p, names[j]);
+		sim_down_semaphore(p, names[j]);
+	}
+	t = now() - t;
+	snprintf(params, sizeof(params), "nsems=%d ", nsems);
+	report("spread", params, iters, t);
+	sim_exit(p);
+	free(names);
+}
+
+/* exit1() of a process owning `owned' semaphores */
+static void
+bench_teardown(int owned)
+{
+	const int iters = 2000;
+	char params[64];
+	double t = 0, start;
+	struct proc *p;
+	int i;
+
+	for (i = 0; i < iters; i++) {
+		p = sim_fork(NULL);
+		fill(p, owned);
+		start = now();
+		sim_exit(p);
+		t += now() - start;
+	}
+	snprintf(params, sizeof(params), "owned=%d ", owned);
+	report("teardown", params, iters, t);
+}
+
+/*
+ * The fixed cost of entering a system call in the harness: no arguments,
+ * six arguments, or a string of `len' chars copied in.  len < 0 is null(),
+ * len == 0 null_args().
+ */
+static void
+bench_null(int len)
+{
+	const int iters = 1000000;
+	struct proc *p = sim_fork(NULL);
+	char params[64], str[1024];
+	double t;
+	int i;
+
+	if (len > 0) {
+		memset(str, 'x', len);
+		str[len] = '\0';
+	}
+	t = now();
+	for (i = 0; i < iters; i++) {
+		if (len < 0)
+			sim_null(p);
+		else if (len == 0)
+			sim_null_args(p, i, i, i, i, i, i);
+		else
+			sim_null_str(p, str, NULL);
+	}
+	t = now() - t;
+	if (len < 0)
+		report("null", "", iters, t);
+	else if (len == 0)
+		report("null_args", "args=6 ", iters, t);
+	else {
+		snprintf(params, sizeof(params), "strlen=%d ", len);
+		report("null_str", params, iters, t);
+	}
+	sim_exit(p);
+}
+
+static void
+bench_churn(void)
+{
+	struct proc *p = sim_fork(NULL);
+	const int iters = 200000;
+	double t;
+	int i;
+
+	t = now();
+	for (i = 0; i < iters; i++) {
+		sim_allocate_semaphore(p, "churn", 0);
+		sim_free_semaphore(p, "churn");
+	}
+	t = now() - t;
+	report("churn", "", iters, t);
+	sim_exit(p);
+}
+
+struct pingpong {
+	struct proc *p;
+	const char *wait, *post;
+	int rounds;
+};
+
+static void *
+pingpong_thread(void *arg)
+{
+	struct pingpong *pp = arg;
+	int i;
+
+	for (i = 0; i < pp->rounds; i++) {
+		sim_down_semaphore(pp->p, pp->wait);
+		sim_up_semaphore(pp->p, pp->post);
+	}
+	return (NULL);
+}
+
+static void
+bench_pingpong(void)
+{
+	struct proc *parent, *child;
+	struct pingpong pp;
+	pthread_t t;
+	const int rounds = 20000;
+	double start;
+	int i;
+
+	parent = sim_fork(NULL);
+	sim_allocate_semaphore(parent, "ping", 0);
+	sim_allocate_semaphore(parent, "pong", 0);
+	child = sim_fork(parent);
+	pp.p = child;
+	pp.wait = "ping";
+	pp.post = "pong";
+	pp.rounds = rounds;
+	pthread_create(&t, NULL, pingpong_thread, &pp);
+	start = now();
+	for (i = 0; i < rounds; i++) {
+		sim_up_semaphore(parent, "ping");
+		sim_down_semaphore(parent, "pong");
+	}
+	start = now() - start;
+	pthread_join(t, NULL);
+	report("pingpong", "", rounds, start);
+	sim_exit(child);
+	sim_exit(parent);
+}
+
+static int
+cmpdouble(const void *a, const void *b)
+{
+	double x = *(const double *)a, y = *(const double *)b;
+
+	return (x < y ? -1 : x > y);
+}
+
+/*
+ * `n' processes taking turns on a count-1 semaphore in FIFO or SEM_BARGE
+ * mode: down(), hold it for a microsecond, up(), repeat.  FIFO hands every
+ * unit to the oldest sleeper and forms a convoy; barging lets the running
+ * process keep it.  Reports throughput and the spread of per-down()
+ * latency.
+ */
+static void
+bench_contend(int n, int barge)
+{
+	struct proc *parent;
+	struct contender c[n];
+	pthread_t t[n];
+	const int rounds = 20000;
+	double start, *lat;
+	int i, total = n * rounds;
+
+	if ((lat = malloc(total * sizeof(*lat))) == NULL) {
+		perror("malloc");
+		exit(1);
+	}
+	parent = sim_fork(NULL);
+	sim_allocate_semaphore_flags(parent, "mutex", 1,
+	    barge ? SEM_BARGE : 0);
+	start = now();
+	for (i = 0; i < n; i++) {
+		c[i].p = sim_fork(parent);
+		c[i].name = "mutex";
+		c[i].rounds = rounds;
+		c[i].hold = 1000;
+		c[i].lat = lat + i * rounds;
+		pthread_create(&t[i], NULL, contender_thread, &c[i]);
+	}
+	for (i = 0; i < n; i++)
+		pthread_join(t[i], NULL);
+	start = now() - start;
+	qsort(lat, total, sizeof(*lat), cmpdouble);
+	printf("bench=contend procs=%d barge=%d iters=%d ns_per_op=%.1f "
+	    "ops_per_sec=%.0f p50_ns=%.0f p99_ns=%.0f max_ns=%.0f\n", n,
+	    barge, total, start * 1e9 / total, total / start,
+	    lat[total / 2] * 1e9, lat[total / 100 * 99] * 1e9,
+	    lat[total - 1] * 1e9);
+	for (i = 0; i < n; i++)
+		sim_exit(c[i].p);
+	sim_exit(parent);
+	free(lat);
+}
+
+#define RING_SLOTS	64
+
+struct pipeline {
+	struct proc *p;
+	int mode;		/* 0 semaphores + ring, 1 channel, 2 batched */
+	int msgs;
+	char ring[RING_SLOTS][16];	/* mode 0: the "shared memory" */
+	int head, tail;
+};
+
+/* One side of bench_channel(): sends msgs if p is the producer */
+static void
+pipeline_run(struct pipeline *pl, int produce)
+{
+	char msg[16], buf[16 * 16];
+	int lens[16], i, j, n;
+
+	memset(msg, 'm', sizeof(msg));
+	for (i = 0; i < 16; i++)
+		lens[i] = sizeof(msg);
+	for (i = 0; i < pl->msgs; i += n) {
+		n = 1;
+		if (pl->mode == 0 && produce) {
+			sim_down_semaphore(pl->p, "space");
+			sim_down_semaphore(pl->p, "lock");
+			memcpy(pl->ring[pl->tail++ % RING_SLOTS], msg,
+			    sizeof(msg));
+			sim_up_semaphore(pl->p, "lock");
+			sim_up_semaphore(pl->p, "items");
+		} else if (pl->mode == 0) {
+			sim_down_semaphore(pl->p, "items");
+			sim_down_semaphore(pl->p, "lock");
+			memcpy(buf, pl->ring[pl->head++ % RING_SLOTS],
+			    sizeof(msg));
+			sim_up_semaphore(pl->p, "lock");
+			sim_up_semaphore(pl->p, "space");
+		} else if (pl->mode == 1 && produce)
+			sim_channel_send(pl->p, "chan", msg, sizeof(msg));
+		else if (pl->mode == 1)
+			sim_channel_receive(pl->p, "chan", buf, sizeof(buf),
+			    NULL);
+		else if (produce) {
+			n = MIN(16, pl->msgs - i);
+			for (j = 0; j < n; j++)
+				memcpy(buf + j * sizeof(msg), msg, sizeof(msg));
+			sim_channel_send_batch(pl->p, "chan", buf, lens, n,
+			    NULL);
+		} else
+			sim_channel_receive_batch(pl->p, "chan", buf,
+			    sizeof(buf), lens, 16, &n);
+	}
+}
+
+static void *
+consumer_thread(void *arg)
+{
+	pipeline_run(arg, 0);
+	return (NULL);
+}
+
+/*
+ * Hand 16 byte messages from one process to another through a ring of 64:
+ * a ring in shared memory guarded by items/space/lock semaphores, the same
+ * through a channel, and through a channel 16 messages per call.
+ */
+static void
+bench_channel(int mode)
+{
+	static const char *modes[] = { "sem", "chan", "batch" };
+	struct pipeline prod, cons;
+	struct proc *parent;
+	pthread_t t;
+	char params[64];
+	double start;
+
+	parent = sim_fork(NULL);
+	if (mode == 0) {
+		sim_allocate_semaphore(parent, "items", 0);
+		sim_allocate_semaphore(parent, "space", RING_SLOTS);
+		sim_allocate_semaphore(parent, "lock", 1);
+	} else
+		sim_allocate_channel(parent, "chan", RING_SLOTS, 16);
+	memset(&prod, 0, sizeof(prod));
+	prod.p = sim_fork(parent);
+	prod.mode = mode;
+	prod.msgs = 200000;
+	cons = prod;
+	cons.p = sim_fork(parent);
+	start = now();
+	pthread_create(&t, NULL, consumer_thread, &cons);
+	pipeline_run(&prod, 1);
+	pthread_join(t, NULL);
+	start = now() - start;
+	snprintf(params, sizeof(params), "mode=%s ", modes[mode]);
+	report("channel", params, prod.msgs, start);
+	sim_exit(prod.p);
+	sim_exit(cons.p);
+	sim_exit(parent);
+}
+
+int
+main(int argc, char *argv[])
+{
+	unsigned long live;
+	int quick;
+
+	quick = (argc > 1 && strcmp(argv[1], "-q") == 0);
+	sim_init();
+	live = sim_allocated();
+
+	check_basic();
+	check_null();
+	check_inheritance();
+	check_teardown();
+	check_pgrp();
+	check_global();
+	check_set();
+	check_barrier();
+	check_kevent();
+	check_any();
+	check_barge();
+	check_mutex();
+	check_channel();
+	check_condition();
+	CHECK(sim_allocated() == live, 1);	/* nothing leaked */
+
+	if (!quick) {
+		bench_null(-1);
+		bench_null(0);
+		bench_null(1);
+		bench_null(64);
+		bench_null(1023);
+		bench_lookup(1, 1);
+		bench_lookup(16, 1);
+		bench_lookup(16, 8);
+		bench_lookup(128, 1);
+		bench_lookup(128, 8);
+		bench_churn();
+		bench_spread(64);
+		bench_spread(1024);
+		bench_spread(16384);
+		bench_teardown(64);
+		bench_bank(64, 0);
+		bench_bank(64, 1);
+		bench_barrier(8, 0);
+		bench_barrier(8, 1);
+		bench_pingpong();
+		bench_contend(4, 0);
+		bench_contend(4, 1);
+		bench_channel(0);
+		bench_channel(1);
+		bench_channel(2);
+	}
+
+	printf("%s\n", failures ? "FAIL" : "ok");
+	return (failures != 0);
+}
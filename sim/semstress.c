@@ -0,0 +1,353 @@
+/*
+ * Randomized fork/semaphore stress test for the simulation harness.
+ *
+ * usage: semstress [-d depth] [-f fanout] [-n names] [-t seconds] [-s seed]
+ *
+ * Builds a process tree up to `depth' levels deep, each node forking
+ * between 0 and `fanout' children (the root at least one), and runs one
+ * worker thread per process until the deadline:
+ *
+ *   L0..Ln  allocated by the root only (count 1..3); workers down() then
+ *           up() them, so at rest every count is back at its initial value
+ *   N0..Nn  allocated again by each interior node for a random subset of
+ *           the names (count 0), shadowing the ancestors' copies; a worker
+ *           only up()s its own copies and up()s or down()s the nearest
+ *           ancestor's copy of the rest at random
+ *   c<pid>  private to each worker, allocated and freed in a loop
+ *
+ * The tree shape and the shadowed names are drawn from the seed, so a seed
+ * reproduces them.  Meanwhile random processes exit in the middle of the
+ * run, tearing down semaphores that descendants may be asleep on and
+ * orphaning their subtrees.  The main thread audits the kernel's wait
+ * queues, in the process lists and the group and global namespaces,
+ * against the counts every few milliseconds.
+ *
+ * Anomalies reported:
+ *   audit     wait queue length disagrees with the count (lost wakeup)
+ *   enoent    L or c<pid> not found by a process still attached to the root
+ *   eexist    c<pid> reported as existing after it was freed
+ *   stall     a worker could not finish once every N was posted and the
+ *             deadline passed
+ * The last line is a key=value summary; the exit status is non-zero if
+ * any anomaly was seen.
+ */
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "sim.h"
+
+struct node {
+	struct proc	*p;
+	struct node	*parent;
+	int		 depth;
+	char		*shadows;	/* shadows[i]: allocated its own Ni */
+	volatile int	 exiting;	/* asked to exit */
+	volatile int	 orphaned;	/* cut off from the root's L names */
+	volatile int	 done;		/* worker returned */
+	int		 gone;		/* process exited */
+	pthread_mutex_t	 lock;		/* serializes gone with drain() */
+	unsigned int	 seed;
+	pthread_t	 thread;
+};
+
+static struct node *nodes;
+static int nnodes;
+static int nnames = 4;
+static volatile int stop;
+
+static unsigned long ops, anomalies, exits, drift;
+static unsigned long enoent, eexist;
+
+#define ATOMIC_INC(v)	__atomic_add_fetch(&(v), 1, __ATOMIC_RELAXED)
+
+static double
+now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (ts.tv_sec + ts.tv_nsec / 1e9);
+}
+
+static void
+anomaly(unsigned long *counter, struct node *n, const char *what,
+    const char *name, int err)
+{
+	ATOMIC_INC(*counter);
+	ATOMIC_INC(anomalies);
+	fprintf(stderr, "anomaly: pid %d %s(%s) = %d\n", sim_pid(n->p), what,
+	    name, err);
+}
+
+/* Orphan n and everything below it before n exits */
+static void
+orphan(struct node *n)
+{
+	int i;
+
+	n->orphaned = 1;
+	for (i = 0; i < nnodes; i++) {
+		struct node *q;
+
+		for (q = nodes[i].parent; q != NULL; q = q->parent)
+			if (q == n) {
+				nodes[i].orphaned = 1;
+				break;
+			}
+	}
+}
+
+static void
+lock_op(struct node *n)
+{
+	char name[16];
+	int err;
+
+	snprintf(name, sizeof(name), "L%d", rand_r(&n->seed) % nnames);
+	if ((err = sim_down_semaphore(n->p, name)) != 0) {
+		if (err == ENOENT && !n->orphaned)
+			anomaly(&enoent, n, "down", name, err);
+		return;
+	}
+	if ((err = sim_up_semaphore(n->p, name)) != 0) {
+		if (err == ENOENT && !n->orphaned)
+			anomaly(&enoent, n, "up", name, err);
+		/* orphaned inside the section: give the root its token back */
+		sim_up_semaphore(nodes[0].p, name);
+		ATOMIC_INC(drift);
+	}
+}
+
+static void
+shadow_op(struct node *n)
+{
+	char name[16];
+	int i;
+
+	/*
+	 * A node resolves a name it shadows to its own copy, so it only ever
+	 * posts there; any other to the nearest ancestor's copy, shared with
+	 * the rest of that subtree, or ENOENT if no ancestor shadows it.
+	 */
+	i = rand_r(&n->seed) % nnames;
+	snprintf(name, sizeof(name), "N%d", i);
+	if (n->shadows[i] || rand_r(&n->seed) % 2)
+		sim_up_semaphore(n->p, name);
+	else
+		sim_down_semaphore(n->p, name);	/* may block */
+}
+
+static void
+private_op(struct node *n)
+{
+	char name[16];
+	int err;
+
+	snprintf(name, sizeof(name), "c%d", sim_pid(n->p));
+	if ((err = sim_allocate_semaphore(n->p, name, 1)) != 0) {
+		anomaly(&eexist, n, "allocate", name, err);
+		return;
+	}
+	sim_up_semaphore(n->p, name);
+	if ((err = sim_down_semaphore(n->p, name)) != 0)
+		anomaly(&enoent, n, "down", name, err);
+	if ((err = sim_free_semaphore(n->p, name)) != 0)
+		anomaly(&enoent, n, "free", name, err);
+}
+
+static void *
+worker(void *arg)
+{
+	struct node *n = arg;
+	int r;
+
+	while (!stop && !n->exiting) {
+		r = rand_r(&n->seed) % 10;
+		if (r < 4)
+			lock_op(n);
+		else if (r < 8)
+			shadow_op(n);
+		else
+			private_op(n);
+		ATOMIC_INC(ops);
+	}
+	if (n->exiting) {
+		orphan(n);
+		pthread_mutex_lock(&n->lock);
+		sim_exit(n->p);
+		n->gone = 1;
+		pthread_mutex_unlock(&n->lock);
+		ATOMIC_INC(exits);
+	}
+	n->done = 1;
+	return (NULL);
+}
+
+static void
+build(int depth, int fanout, unsigned int seed)
+{
+	char name[16];
+	unsigned int shape = seed;
+	int i, j, levelsz, maxnodes, first, next, nkids;
+
+	for (i = 0, levelsz = 1, maxnodes = 0; i <= depth;
+	    i++, levelsz *= fanout)
+		maxnodes += levelsz;
+	if ((nodes = calloc(maxnodes, sizeof(*nodes))) == NULL) {
+		perror("calloc");
+		exit(1);
+	}
+
+	/* breadth first, so a parent is always set up before its children */
+	nodes[0].p = sim_fork(NULL);
+	for (i = 0; i < nnames; i++) {
+		snprintf(name, sizeof(name), "L%d", i);
+		sim_allocate_semaphore(nodes[0].p, name, 1 + i % 3);
+	}
+	for (first = 0, next = 1; first < next; first++) {
+		struct node *n = &nodes[first];
+
+		n->seed = seed + first;
+		pthread_mutex_init(&n->lock, NULL);
+		if ((n->shadows = calloc(nnames, 1)) == NULL) {
+			perror("calloc");
+			exit(1);
+		}
+		if (n->depth == depth)
+			continue;
+		/* the root always forks, or there would be nothing to exit */
+		nkids = rand_r(&shape) % (fanout + 1);
+		if (first == 0 && nkids == 0)
+			nkids = 1;
+		for (i = 0; i < nnames && nkids > 0; i++) {
+			if (rand_r(&shape) % 2 == 0)
+				continue;
+			n->shadows[i] = 1;
+			snprintf(name, sizeof(name), "N%d", i);
+			sim_allocate_semaphore(n->p, name, 0);
+		}
+		for (j = 0; j < nkids; j++, next++) {
+			nodes[next].parent = n;
+			nodes[next].depth = n->depth + 1;
+			nodes[next].p = sim_fork(n->p);
+		}
+	}
+	nnodes = next;
+}
+
+/*
+ * Post every N visible from every process still alive, finished or not,
+ * until all workers are done: a waiter may be queued on the N of a process
+ * whose own worker has already returned.
+ */
+static int
+drain(double patience)
+{
+	char name[16];
+	double give_up = now() + patience;
+	int i, j, left;
+
+	do {
+		left = 0;
+		for (i = 0; i < nnodes; i++) {
+			if (!nodes[i].done)
+				left++;
+			pthread_mutex_lock(&nodes[i].lock);
+			for (j = 0; j < nnames && !nodes[i].gone; j++) {
+				snprintf(name, sizeof(name), "N%d", j);
+				sim_up_semaphore(nodes[i].p, name);
+			}
+			pthread_mutex_unlock(&nodes[i].lock);
+		}
+		usleep(1000);
+	} while (left > 0 && now() < give_up);
+	return (left);
+}
+
+int
+main(int argc, char *argv[])
+{
+	int depth = 3, fanout = 3, seconds = 2, ch, i, stalled;
+	unsigned int seed = time(NULL);
+	unsigned long audit = 0;
+	double start, elapsed, next_exit;
+
+	while ((ch = getopt(argc, argv, "d:f:n:t:s:")) != -1) {
+		switch (ch) {
+		case 'd':
+			depth = atoi(optarg);
+			break;
+		case 'f':
+			fanout = atoi(optarg);
+			break;
+		case 'n':
+			nnames = atoi(optarg);
+			break;
+		case 't':
+			seconds = atoi(optarg);
+			break;
+		case 's':
+			seed = strtoul(optarg, NULL, 0);
+			break;
+		default:
+			fprintf(stderr, "usage: semstress [-d depth] "
+			    "[-f fanout] [-n names] [-t seconds] [-s seed]\n");
+			return (1);
+		}
+	}
+	if (depth < 1 || fanout < 1 || nnames < 1 || seconds < 1) {
+		fprintf(stderr, "semstress: bad arguments\n");
+		return (1);
+	}
+
+	sim_init();
+	srand(seed);
+	build(depth, fanout, seed);
+
+	start = now();
+	for (i = 0; i < nnodes; i++)
+		pthread_create(&nodes[i].thread, NULL, worker, &nodes[i]);
+
+	/* exit a random non-root process every tenth of the run */
+	next_exit = start + seconds / 10.0;
+	while ((elapsed = now() - start) < seconds) {
+		if (sim_audit() != 0) {
+			audit++;
+			anomalies++;
+		}
+		if (now() >= next_exit) {
+			i = 1 + rand() % (nnodes - 1);
+			if (!nodes[i].exiting && !nodes[i].orphaned)
+				nodes[i].exiting = 1;
+			next_exit += seconds / 10.0;
+		}
+		usleep(2000);
+	}
+	stop = 1;
+	stalled = drain(5.0);
+	if (stalled != 0) {
+		anomalies += stalled;
+		fprintf(stderr, "anomaly: %d workers stalled\n", stalled);
+		return (1);	/* threads still blocked: cannot join */
+	}
+	elapsed = now() - start;
+	for (i = 0; i < nnodes; i++)
+		pthread_join(nodes[i].thread, NULL);
+	if (sim_audit() != 0) {
+		audit++;
+		anomalies++;
+	}
+
+	printf("bench=stress seed=%u depth=%d fanout=%d procs=%d names=%d "
+	    "ops=%lu ops_per_sec=%.0f exits=%lu drift=%lu audit=%lu "
+	    "enoent=%lu eexist=%lu stall=%d anomalies=%lu\n", seed, depth,
+	    fanout, nnodes, nnames, ops, ops / elapsed, exits, drift, audit,
+	    enoent, eexist, stalled, anomalies);
+	return (anomalies != 0);
+}
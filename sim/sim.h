@@ -0,0 +1,103 @@
+/*
+ * User-side interface of the semaphore simulation harness.
+ *
+ * Drivers never see the kernel headers: a simulated process is an opaque
+ * struct proc, and each sim_*() call enters the real cop4600.c system call
+ * under the giant lock exactly as the trap handler would, returning the
+ * errno value the system call produced.
+ */
+
+#ifndef _SIM_H_
+#define _SIM_H_
+
+#include <stddef.h>
+
+struct proc;
+struct knote;
+struct cipher_vec;
+
+void	sim_init(void);
+struct proc *sim_fork(struct proc *parent);
+void	sim_exit(struct proc *p);
+void	sim_setpgrp(struct proc *p);	/* make p leader of a new group */
+void	sim_setcred(struct proc *p, int uid, int gid);
+int	sim_pid(struct proc *p);
+void	sim_setnice(struct proc *p, int nice);
+int	sim_priority(struct proc *p);	/* user priority, lower is better */
+int	sim_audit(void);		/* wait queue/count consistency */
+
+/*
+ * Between sim_enter() and sim_leave() the calling thread keeps the giant
+ * lock across system calls, so nothing woken by one call can run before
+ * the next: an interleaving the scheduler is free to produce but threads
+ * rarely do.  Only sim_*() system calls may be made in between, and none
+ * of them may sleep.
+ */
+void	sim_enter(void);
+void	sim_leave(void);
+
+/* no-op calls: the harness's own cost per system call */
+int	sim_null(struct proc *p);
+int	sim_null_args(struct proc *p, long a1, long a2, long a3, long a4,
+	    long a5, long a6);
+int	sim_null_str(struct proc *p, const char *str, int *len);
+
+int	sim_allocate_semaphore(struct proc *p, const char *name, int count);
+int	sim_down_semaphore(struct proc *p, const char *name);
+int	sim_up_semaphore(struct proc *p, const char *name);
+int	sim_free_semaphore(struct proc *p, const char *name);
+int	sim_allocate_semaphore_scope(struct proc *p, const char *name,
+	    int count, int scope);
+int	sim_open_semaphore(struct proc *p, const char *name, int oflag,
+	    int mode, int count);
+int	sim_allocate_semaphore_set(struct proc *p, const char *name,
+	    int nsems, int count);
+int	sim_down_semaphore_index(struct proc *p, const char *name, int index);
+int	sim_up_semaphore_index(struct proc *p, const char *name, int index);
+int	sim_allocate_barrier(struct proc *p, const char *name, int parties);
+int	sim_wait_barrier(struct proc *p, const char *name, int *phase);
+int	sim_down_semaphore_any(struct proc *p, const char **names, int n,
+	    int *which);
+int	sim_allocate_semaphore_flags(struct proc *p, const char *name,
+	    int count, int flags);
+int	sim_allocate_channel(struct proc *p, const char *name, int capacity,
+	    int msgsize);
+int	sim_channel_send(struct proc *p, const char *name, const void *msg,
+	    int len);
+int	sim_channel_receive(struct proc *p, const char *name, void *msg,
+	    int len, int *got);
+int	sim_channel_send_batch(struct proc *p, const char *name,
+	    const void *msgs, const int *lens, int n, int *sent);
+int	sim_channel_receive_batch(struct proc *p, const char *name,
+	    void *msgs, int len, int *lens, int n, int *got);
+int	sim_allocate_condition(struct proc *p, const char *name);
+int	sim_wait_condition(struct proc *p, const char *name, const char *mutex);
+int	sim_signal_condition(struct proc *p, const char *name, int *woken);
+int	sim_broadcast_condition(struct proc *p, const char *name, int *woken);
+int	sim_cipher(struct proc *p, char *text, int lkey, int nkey, int *len);
+int	sim_cipher_buffer(struct proc *p, void *buf, size_t len, int lkey,
+	    int nkey, size_t *done);
+int	sim_cipher_vector(struct proc *p, struct cipher_vec *vec, int nvec,
+	    int flags, int lkey, int nkey, int *ok);
+int	sim_decipher_buffer(struct proc *p, void *buf, size_t len, int lkey,
+	    int nkey, size_t *done);
+
+/* EVFILT_SEMAPHORE notes, scanned by hand in place of a kqueue */
+struct knote *sim_kevent_attach(struct proc *p, const char *name, int index,
+	    int *error);
+int	sim_kevent_scan(struct knote *kn, long *data, int *eof);
+void	sim_kevent_detach(struct knote *kn);
+
+/*
+ * The cipher passes of cop4600.c, called directly by the drivers to check
+ * them against each other and to time them on buffers larger than one
+ * sys_cipher() call takes.
+ */
+void	substitution(char *text, int len, int lkey, int nkey);
+unsigned char *substitution_table(int lkey, int nkey);
+unsigned char *inverse_table(int lkey, int nkey);
+void	cipher_apply(char *text, int len, unsigned char *table);
+
+unsigned long sim_allocated(void);	/* live kernel malloc(9) blocks */
+
+#endif /* !_SIM_H_ */
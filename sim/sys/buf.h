@@ -0,0 +1,12 @@
+/*
+ * Simulation stub for <sys/buf.h>: only the transfer directions, as
+ * passed to uvm_useracc().
+ */
+
+#ifndef _SIM_SYS_BUF_H_
+#define _SIM_SYS_BUF_H_
+
+#define	B_WRITE		0x00000000	/* Write buffer (pseudo flag). */
+#define	B_READ		0x00100000	/* Read buffer. */
+
+#endif /* !_SIM_SYS_BUF_H_ */
@@ -0,0 +1,74 @@
+/*
+ * Simulation stub for <sys/event.h>.
+ *
+ * Just enough of the kqueue kernel interface for a filter to be attached,
+ * fired and detached: knote() marks a note active the way kern_event.c
+ * does, and the harness plays kqueue_register()/kqueue_scan() around it.
+ */
+
+#ifndef _SIM_SYS_EVENT_H_
+#define _SIM_SYS_EVENT_H_
+
+#include <stdint.h>
+#include <sys/queue.h>
+
+#define EVFILT_READ		(-1)
+#define EVFILT_WRITE		(-2)
+#define EVFILT_AIO		(-3)
+#define EVFILT_VNODE		(-4)
+#define EVFILT_PROC		(-5)
+#define EVFILT_SIGNAL		(-6)
+#define EVFILT_SEMAPHORE	(-7)
+
+#define EVFILT_SYSCOUNT		7
+
+struct kevent {
+	uintptr_t	ident;		/* identifier for this event */
+	short		filter;		/* filter for event */
+	unsigned short	flags;
+	unsigned int	fflags;
+	intptr_t	data;
+	void		*udata;		/* opaque user data identifier */
+};
+
+#define EV_ONESHOT	0x0010		/* only report one occurrence */
+#define EV_CLEAR	0x0020		/* clear event state after reporting */
+#define EV_EOF		0x8000		/* EOF detected */
+
+struct knote;
+SLIST_HEAD(klist, knote);
+
+#ifdef _KERNEL
+
+#define KNOTE(list, hint)	if ((list) != NULL) knote((list), (hint))
+
+struct filterops {
+	int	f_isfd;		/* true if ident == filedescriptor */
+	int	(*f_attach)(struct knote *kn);
+	void	(*f_detach)(struct knote *kn);
+	int	(*f_event)(struct knote *kn, long hint);
+};
+
+struct knote {
+	SLIST_ENTRY(knote)	kn_selnext;	/* for struct selinfo */
+	struct			kevent kn_kevent;
+	int			kn_status;
+	int			kn_sfflags;	/* saved filter flags */
+	intptr_t		kn_sdata;	/* saved data field */
+	const struct		filterops *kn_fop;
+	void			*kn_hook;
+};
+
+#define KN_ACTIVE	0x01			/* event has been triggered */
+
+#define kn_id		kn_kevent.ident
+#define kn_filter	kn_kevent.filter
+#define kn_flags	kn_kevent.flags
+#define kn_fflags	kn_kevent.fflags
+#define kn_data		kn_kevent.data
+
+void	knote(struct klist *list, long hint);
+
+#endif /* _KERNEL */
+
+#endif /* !_SIM_SYS_EVENT_H_ */
@@ -0,0 +1,25 @@
+/*
+ * Simulation stub for <sys/lock.h>.
+ *
+ * Every simulated system call runs under a single giant lock that is only
+ * dropped inside tsleep(), which models the non-preemptive uniprocessor
+ * OpenBSD 3.5 kernel.  A simple lock therefore never has to spin; like a
+ * LOCKDEBUG kernel it only records that it is held, so that misuse (taking
+ * it twice, releasing it unheld, sleeping with it held) panics instead of
+ * silently passing.
+ */
+
+#ifndef _SIM_SYS_LOCK_H_
+#define _SIM_SYS_LOCK_H_
+
+struct simplelock {
+	int	lock_data;
+};
+
+#define SIMPLELOCK_INITIALIZER	{ 0 }
+
+void	simple_lock_init(struct simplelock *);
+void	simple_lock(struct simplelock *);
+void	simple_unlock(struct simplelock *);
+
+#endif /* !_SIM_SYS_LOCK_H_ */
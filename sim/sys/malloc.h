@@ -0,0 +1,25 @@
+/*
+ * Simulation stub for <sys/malloc.h>: kernel malloc(9) on top of the host
+ * allocator.  Only included by kernel-side translation units, so the
+ * macros do not collide with libc.
+ */
+
+#ifndef _SIM_SYS_MALLOC_H_
+#define _SIM_SYS_MALLOC_H_
+
+#include <sys/types.h>
+
+#define	M_WAITOK	0x0000
+#define	M_NOWAIT	0x0001
+#define	M_ZERO		0x0008
+
+#define	M_PROC		41
+#define	M_TEMP		127
+
+void	*sim_malloc(unsigned long size, int type, int flags);
+void	sim_free(void *addr, int type);
+
+#define	malloc(size, type, flags)	sim_malloc((size), (type), (flags))
+#define	free(addr, type)		sim_free((addr), (type))
+
+#endif /* !_SIM_SYS_MALLOC_H_ */
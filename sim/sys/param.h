@@ -0,0 +1,37 @@
+/*
+ * Simulation stub for <sys/param.h>: basic types and errno values.
+ */
+
+#ifndef _SIM_SYS_PARAM_H_
+#define _SIM_SYS_PARAM_H_
+
+#include <sys/types.h>
+#include <stddef.h>
+#include <errno.h>
+
+#ifndef NULL
+#define NULL	((void *)0)
+#endif
+
+#define	PSWP	0
+#define	PVM	4
+#define	PINOD	8
+#define	PRIBIO	16
+#define	PVFS	20
+#define	PZERO	22
+#define	PSOCK	24
+#define	PWAIT	32
+#define	PLOCK	36
+#define	PPAUSE	40
+#define	PUSER	50
+#define	MAXPRI	127
+
+#define	PCATCH	0x100
+#define	PNORELOCK 0x200
+
+#define	hz	100
+
+#define	MIN(a,b) (((a)<(b))?(a):(b))
+#define	MAX(a,b) (((a)>(b))?(a):(b))
+
+#endif /* !_SIM_SYS_PARAM_H_ */
@@ -0,0 +1,74 @@
+/*
+ * Simulation stub for <sys/proc.h>.
+ *
+ * Only the members of struct proc that the semaphore code touches are
+ * modelled here; keep them in step with ../../proc.h.  The semaphore
+ * declarations themselves live after the _SYS_PROC_H_ guard of the real
+ * header and are pulled in verbatim from there.
+ */
+
+#ifndef _SIM_SYS_PROC_H_
+#define _SIM_SYS_PROC_H_
+
+#include <sys/param.h>
+#include <sys/queue.h>
+#include <sys/event.h>
+#include <sys/lock.h>
+
+struct	ucred {
+	u_short	cr_ref;			/* reference count */
+	uid_t	cr_uid;			/* effective user id */
+	gid_t	cr_gid;			/* effective group id */
+	short	cr_ngroups;		/* number of groups */
+	gid_t	cr_groups[16];		/* groups */
+};
+
+struct	pcred {
+	struct	ucred *pc_ucred;	/* Current credentials. */
+};
+
+struct	pgrp {
+	LIST_HEAD(, proc) pg_members;	/* Pointer to pgrp members. */
+	pid_t	pg_id;			/* Pgrp id. */
+};
+
+struct	proc {
+	LIST_ENTRY(proc) p_list;	/* List of all processes. */
+	struct	pcred *p_cred;		/* Process owner's identity. */
+	int	p_flag;			/* P_* flags. */
+	pid_t	p_pid;			/* Process identifier. */
+	LIST_ENTRY(proc) p_pglist;	/* List of processes in pgrp. */
+	struct	proc *p_pptr;		/* Pointer to parent process. */
+	LIST_ENTRY(proc) p_sibling;	/* List of sibling processes. */
+	LIST_HEAD(, proc) p_children;	/* Pointer to list of children. */
+	char	p_stat;			/* S* process status. */
+	u_char	p_priority;		/* Process priority. */
+	u_char	p_usrpri;	/* User-priority based on p_cpu and p_nice. */
+	char	p_nice;		/* Process "nice" value. */
+	struct	pgrp *p_pgrp;		/* Pointer to process group. */
+
+	int inherited; 		/* Flag to check if process should semaphores from parent */
+	LIST_HEAD(s_list, semaphore) semaphores;	/* Semaphores the process owns */
+	LIST_HEAD(, semaphore) p_semheld;	/* SEM_MUTEX semaphores the process holds */
+};
+
+#define	p_ucred		p_cred->pc_ucred
+
+#define	SRUN	2		/* Currently runnable. */
+#define	SSLEEP	3		/* Sleeping on an address. */
+
+#define	P_INMEM		0x000004	/* Loaded into memory. */
+#define	P_WEXIT		0x002000	/* Working on exiting. */
+
+int	groupmember(gid_t, struct ucred *);
+void	remrunqueue(struct proc *);
+void	resetpriority(struct proc *);
+void	setrunqueue(struct proc *);
+
+extern __thread struct proc *sim_curproc;
+#define	curproc	sim_curproc
+
+#define	_SYS_PROC_H_
+#include "../../proc.h"
+
+#endif /* !_SIM_SYS_PROC_H_ */
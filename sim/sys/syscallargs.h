@@ -0,0 +1,206 @@
+/*
+ * Simulation stub for <sys/syscallargs.h>: argument structures for the
+ * COP4600 system calls, mirroring their entries in ../../syscalls.master.
+ */
+
+#ifndef _SIM_SYS_SYSCALLARGS_H_
+#define _SIM_SYS_SYSCALLARGS_H_
+
+#define	syscallarg(x)	struct { x datum; }
+#define	SCARG(p, k)	((p)->k.datum)
+
+struct sys_showargs_args {
+	syscallarg(const char *) str;
+	syscallarg(int) val;
+};
+
+struct sys_null_args_args {
+	syscallarg(long) a1;
+	syscallarg(long) a2;
+	syscallarg(long) a3;
+	syscallarg(long) a4;
+	syscallarg(long) a5;
+	syscallarg(long) a6;
+};
+
+struct sys_null_str_args {
+	syscallarg(const char *) str;
+};
+
+struct sys_cipher_args {
+	syscallarg(char *) text;
+	syscallarg(int) lkey;
+	syscallarg(int) nkey;
+};
+
+struct sys_cipher_buffer_args {
+	syscallarg(char *) buf;
+	syscallarg(size_t) len;
+	syscallarg(int) lkey;
+	syscallarg(int) nkey;
+};
+
+struct sys_cipher_vector_args {
+	syscallarg(struct cipher_vec *) vec;
+	syscallarg(int) nvec;
+	syscallarg(int) flags;
+	syscallarg(int) lkey;
+	syscallarg(int) nkey;
+};
+
+struct sys_decipher_buffer_args {
+	syscallarg(char *) buf;
+	syscallarg(size_t) len;
+	syscallarg(int) lkey;
+	syscallarg(int) nkey;
+};
+
+struct sys_allocate_semaphore_args {
+	syscallarg(const char *) name;
+	syscallarg(int) initial_count;
+};
+
+struct sys_down_semaphore_args {
+	syscallarg(const char *) name;
+};
+
+struct sys_up_semaphore_args {
+	syscallarg(const char *) name;
+};
+
+struct sys_free_semaphore_args {
+	syscallarg(const char *) name;
+};
+
+struct sys_allocate_semaphore_scope_args {
+	syscallarg(const char *) name;
+	syscallarg(int) initial_count;
+	syscallarg(int) scope;
+};
+
+struct sys_open_semaphore_args {
+	syscallarg(const char *) name;
+	syscallarg(int) oflag;
+	syscallarg(int) mode;
+	syscallarg(int) initial_count;
+};
+
+struct sys_allocate_semaphore_set_args {
+	syscallarg(const char *) name;
+	syscallarg(int) nsems;
+	syscallarg(int) initial_count;
+};
+
+struct sys_down_semaphore_index_args {
+	syscallarg(const char *) name;
+	syscallarg(int) index;
+};
+
+struct sys_up_semaphore_index_args {
+	syscallarg(const char *) name;
+	syscallarg(int) index;
+};
+
+struct sys_allocate_barrier_args {
+	syscallarg(const char *) name;
+	syscallarg(int) parties;
+};
+
+struct sys_wait_barrier_args {
+	syscallarg(const char *) name;
+};
+
+struct sys_down_semaphore_any_args {
+	syscallarg(const char **) names;
+	syscallarg(int) nnames;
+};
+
+struct sys_allocate_semaphore_flags_args {
+	syscallarg(const char *) name;
+	syscallarg(int) initial_count;
+	syscallarg(int) flags;
+};
+
+struct sys_allocate_channel_args {
+	syscallarg(const char *) name;
+	syscallarg(int) capacity;
+	syscallarg(int) msgsize;
+};
+
+struct sys_channel_send_args {
+	syscallarg(const char *) name;
+	syscallarg(const void *) msg;
+	syscallarg(int) len;
+};
+
+struct sys_channel_receive_args {
+	syscallarg(const char *) name;
+	syscallarg(void *) msg;
+	syscallarg(int) len;
+};
+
+struct sys_channel_send_batch_args {
+	syscallarg(const char *) name;
+	syscallarg(const void *) msgs;
+	syscallarg(const int *) lens;
+	syscallarg(int) nmsgs;
+};
+
+struct sys_channel_receive_batch_args {
+	syscallarg(const char *) name;
+	syscallarg(void *) msgs;
+	syscallarg(int) len;
+	syscallarg(int *) lens;
+	syscallarg(int) nmsgs;
+};
+
+struct sys_allocate_condition_args {
+	syscallarg(const char *) name;
+};
+
+struct sys_wait_condition_args {
+	syscallarg(const char *) name;
+	syscallarg(const char *) mutex;
+};
+
+struct sys_signal_condition_args {
+	syscallarg(const char *) name;
+};
+
+struct sys_broadcast_condition_args {
+	syscallarg(const char *) name;
+};
+
+int	sys_hello(struct proc *, void *, register_t *);
+int	sys_showargs(struct proc *, void *, register_t *);
+int	sys_cipher(struct proc *, void *, register_t *);
+int	sys_allocate_semaphore(struct proc *, void *, register_t *);
+int	sys_down_semaphore(struct proc *, void *, register_t *);
+int	sys_up_semaphore(struct proc *, void *, register_t *);
+int	sys_free_semaphore(struct proc *, void *, register_t *);
+int	sys_allocate_semaphore_scope(struct proc *, void *, register_t *);
+int	sys_open_semaphore(struct proc *, void *, register_t *);
+int	sys_allocate_semaphore_set(struct proc *, void *, register_t *);
+int	sys_down_semaphore_index(struct proc *, void *, register_t *);
+int	sys_up_semaphore_index(struct proc *, void *, register_t *);
+int	sys_allocate_barrier(struct proc *, void *, register_t *);
+int	sys_wait_barrier(struct proc *, void *, register_t *);
+int	sys_down_semaphore_any(struct proc *, void *, register_t *);
+int	sys_allocate_semaphore_flags(struct proc *, void *, register_t *);
+int	sys_allocate_channel(struct proc *, void *, register_t *);
+int	sys_channel_send(struct proc *, void *, register_t *);
+int	sys_channel_receive(struct proc *, void *, register_t *);
+int	sys_channel_send_batch(struct proc *, void *, register_t *);
+int	sys_channel_receive_batch(struct proc *, void *, register_t *);
+int	sys_allocate_condition(struct proc *, void *, register_t *);
+int	sys_wait_condition(struct proc *, void *, register_t *);
+int	sys_signal_condition(struct proc *, void *, register_t *);
+int	sys_broadcast_condition(struct proc *, void *, register_t *);
+int	sys_cipher_buffer(struct proc *, void *, register_t *);
+int	sys_cipher_vector(struct proc *, void *, register_t *);
+int	sys_decipher_buffer(struct proc *, void *, register_t *);
+int	sys_null(struct proc *, void *, register_t *);
+int	sys_null_args(struct proc *, void *, register_t *);
+int	sys_null_str(struct proc *, void *, register_t *);
+
+#endif /* !_SIM_SYS_SYSCALLARGS_H_ */
@@ -0,0 +1,40 @@
+/*
+ * Simulation stub for <sys/systm.h>: the kernel support routines used by
+ * cop4600.c, implemented by kern_sim.c.
+ */
+
+#ifndef _SIM_SYS_SYSTM_H_
+#define _SIM_SYS_SYSTM_H_
+
+#include <sys/types.h>
+#include <stddef.h>
+
+int	sim_copyinstr(const void *, void *, size_t, void *, size_t);
+int	sim_copyoutstr(const void *, void *, size_t, void *, size_t);
+int	sim_copystr(const void *, void *, size_t, void *, size_t);
+int	copyin(const void *, void *, size_t);
+int	copyout(const void *, void *, size_t);
+
+/*
+ * The semaphore code hands an int to the "done" argument where the kernel
+ * prototype says size_t.  Harmless on i386; pass the width along so the
+ * host does not scribble past it.
+ */
+#define	copyinstr(from, to, max, done) \
+	sim_copyinstr((from), (to), (max), (done), sizeof(*(done)))
+#define	copyoutstr(from, to, max, done) \
+	sim_copyoutstr((from), (to), (max), (done), sizeof(*(done)))
+#define	copystr(from, to, max, done) \
+	sim_copystr((from), (to), (max), (done), sizeof(*(done)))
+
+int	tsleep(void *chan, int pri, const char *wmesg, int timo);
+void	wakeup(void *chan);
+void	uprintf(const char *, ...);
+void	panic(const char *, ...);
+
+int	strcmp(const char *, const char *);
+void	*memcpy(void *, const void *, size_t);
+void	*memset(void *, int, size_t);
+size_t	strlen(const char *);
+
+#endif /* !_SIM_SYS_SYSTM_H_ */
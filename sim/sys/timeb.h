@@ -0,0 +1,3 @@
+/*
+ * Simulation stub: nothing from <sys/timeb.h> is used by cop4600.c.
+ */
@@ -0,0 +1,3 @@
+/*
+ * Simulation stub: nothing from <sys/times.h> is used by cop4600.c.
+ */
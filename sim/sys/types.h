@@ -0,0 +1,6 @@
+/*
+ * Simulation stub: the host <sys/types.h> already provides the BSD
+ * u_char/u_int64_t/register_t family used by the kernel sources.
+ */
+
+#include_next <sys/types.h>
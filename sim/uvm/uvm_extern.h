@@ -0,0 +1,15 @@
+/*
+ * Simulation stub for <uvm/uvm_extern.h>.
+ *
+ * The only user address the simulation treats as unmapped is NULL, as in
+ * copyin() and copyout(), so uvm_useracc() agrees with them.
+ */
+
+#ifndef _SIM_UVM_UVM_EXTERN_H_
+#define _SIM_UVM_UVM_EXTERN_H_
+
+#include <sys/types.h>
+
+int	uvm_useracc(caddr_t addr, size_t len, int rw);
+
+#endif /* !_SIM_UVM_UVM_EXTERN_H_ */